@@ -307,6 +307,16 @@ partition_read (void *p_, block_sector_t sector, void *buffer)
   block_read (p->block, p->start + sector, buffer);
 }
 
+/* Reads CNT consecutive sectors from partition P, starting at
+   SECTOR, into BUFFERS, one sector into each element. */
+static void
+partition_read_multiple (void *p_, block_sector_t sector, size_t cnt,
+                         void *buffers[])
+{
+  struct partition *p = p_;
+  block_read_multiple (p->block, p->start + sector, cnt, buffers);
+}
+
 /* Write sector SECTOR to partition P from BUFFER, which must
    contain BLOCK_SECTOR_SIZE bytes.  Returns after the block has
    acknowledged receiving the data. */
@@ -320,5 +330,6 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_multiple
   };
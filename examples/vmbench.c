@@ -0,0 +1,197 @@
+/* vmbench.c
+
+   Benchmark program that measures the virtual memory system
+   under several page access patterns and memory sizes.
+
+   For each run, it grows the heap by the given size, touches
+   every page once, and then makes a number of passes over the
+   pages in one of these orders:
+
+        seq     every page in address order.
+        rand    as many pages as the region has, chosen at random.
+        stride  every 16th page, then every 16th page starting one
+                page further on, and so on, which defeats any
+                read-ahead or fault-around.
+        hot     nine accesses out of ten to a random page in the
+                first eighth of the region and the rest to a random
+                page anywhere, a working set inside a larger one.
+
+   Sizes larger than the memory given to Pintos show how the
+   patterns behave once the working set no longer fits; run
+   those with enough swap, e.g.
+
+        pintos --swap-size=16 -- -q run 'vmbench'
+        pintos --swap-size=16 -- -q run 'vmbench rand 4096 8'
+
+   With no arguments, every pattern runs at every size in SIZES.
+   Otherwise the arguments are a pattern, a size in kB, and a
+   number of passes, each of which may be omitted from the end.
+
+   Each run prints one line of space-separated key=value fields,
+   which stays the same across kernel builds so that the output
+   of two builds can be compared line by line:
+
+        vmbench pattern=seq kb=512 pages=128 passes=4 ticks=3
+          faults=0 swap_in=0 swap_out=0 evictions=0 rss=131
+          swapped=0 pt=3
+
+   (shown wrapped here).  The counts cover only the passes, not
+   the first touch of each page, and rss, swapped, and pt are the
+   process's resident and swapped-out pages and its page tables
+   when the passes are done.  A run that cannot get its memory
+   prints error=sbrk after the size instead. */
+
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+
+/* Pages between accesses in the "stride" pattern. */
+#define STRIDE 16
+
+/* Default passes and sizes, in kB. */
+#define PASSES 4
+static const int SIZES[] = {64, 512, 2048, 8192};
+
+/* Touches page PAGE of BUF. */
+static void
+touch (volatile uint8_t *buf, size_t page)
+{
+  buf[page * PAGE_SIZE + page % PAGE_SIZE]++;
+}
+
+/* One pass over the PAGE_CNT pages of BUF in each order. */
+static void
+pass_seq (volatile uint8_t *buf, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    touch (buf, i);
+}
+
+static void
+pass_rand (volatile uint8_t *buf, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    touch (buf, random_ulong () % page_cnt);
+}
+
+static void
+pass_stride (volatile uint8_t *buf, size_t page_cnt)
+{
+  size_t start, i;
+
+  for (start = 0; start < STRIDE; start++)
+    for (i = start; i < page_cnt; i += STRIDE)
+      touch (buf, i);
+}
+
+static void
+pass_hot (volatile uint8_t *buf, size_t page_cnt)
+{
+  size_t hot_cnt = page_cnt / 8 > 0 ? page_cnt / 8 : 1;
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    if (random_ulong () % 10 != 0)
+      touch (buf, random_ulong () % hot_cnt);
+    else
+      touch (buf, random_ulong () % page_cnt);
+}
+
+/* An access pattern. */
+struct pattern
+  {
+    const char *name;
+    void (*pass) (volatile uint8_t *, size_t page_cnt);
+  };
+
+static const struct pattern patterns[] =
+  {
+    {"seq", pass_seq},
+    {"rand", pass_rand},
+    {"stride", pass_stride},
+    {"hot", pass_hot},
+  };
+
+#define PATTERN_CNT (sizeof patterns / sizeof *patterns)
+
+/* Runs PASSES passes of pattern P over KB kB of fresh heap and
+   prints the result line. */
+static void
+run (const struct pattern *p, int kb, int passes)
+{
+  size_t page_cnt = (size_t) kb * 1024 / PAGE_SIZE;
+  size_t size = page_cnt * PAGE_SIZE;
+  struct vmstat before, after;
+  uint8_t *buf;
+  int i;
+
+  buf = sbrk (size);
+  if (buf == (void *) -1)
+    {
+      printf ("vmbench pattern=%s kb=%d error=sbrk\n", p->name, kb);
+      return;
+    }
+
+  /* Same random sequence in every run, and in every build. */
+  random_init (kb);
+  for (i = 0; (size_t) i < page_cnt; i++)
+    buf[(size_t) i * PAGE_SIZE] = 1;
+
+  vmstat (&before);
+  for (i = 0; i < passes; i++)
+    p->pass (buf, page_cnt);
+  vmstat (&after);
+
+  printf ("vmbench pattern=%s kb=%d pages=%zu passes=%d ticks=%lld "
+          "faults=%lld swap_in=%lld swap_out=%lld evictions=%lld "
+          "rss=%lld swapped=%lld pt=%lld\n",
+          p->name, kb, page_cnt, passes, after.ticks - before.ticks,
+          after.page_faults - before.page_faults,
+          after.swap_ins - before.swap_ins,
+          after.swap_outs - before.swap_outs,
+          after.evictions - before.evictions,
+          after.resident_pages, after.swapped_pages, after.page_tables);
+
+  sbrk (-(intptr_t) size);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const struct pattern *p;
+  size_t i, j;
+
+  if (argc < 2)
+    {
+      for (i = 0; i < PATTERN_CNT; i++)
+        for (j = 0; j < sizeof SIZES / sizeof *SIZES; j++)
+          run (&patterns[i], SIZES[j], PASSES);
+      return EXIT_SUCCESS;
+    }
+
+  p = NULL;
+  for (i = 0; i < PATTERN_CNT; i++)
+    if (!strcmp (argv[1], patterns[i].name))
+      p = &patterns[i];
+  if (p == NULL)
+    {
+      printf ("usage: vmbench [seq|rand|stride|hot [KB [PASSES]]]\n");
+      return EXIT_FAILURE;
+    }
+
+  if (argc < 3)
+    for (j = 0; j < sizeof SIZES / sizeof *SIZES; j++)
+      run (p, SIZES[j], PASSES);
+  else
+    run (p, atoi (argv[2]), argc > 3 ? atoi (argv[3]) : PASSES);
+  return EXIT_SUCCESS;
+}
@@ -216,6 +216,21 @@ inode_open (block_sector_t sector)
   return inode;
 }
 
+/* Returns true if SECTOR, which may come from outside the
+   kernel, is within the file system device and holds an inode,
+   as far as can be told from its magic number, so that it may be
+   passed to inode_open(). */
+bool
+inode_exists (block_sector_t sector)
+{
+  struct inode_disk disk_inode;
+
+  if (sector >= block_size (fs_device))
+    return false;
+  block_read (fs_device, sector, &disk_inode);
+  return disk_inode.magic == INODE_MAGIC;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
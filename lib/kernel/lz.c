@@ -0,0 +1,208 @@
+#include "lz.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* A byte-oriented LZ77 compressor in the style of LZ4.
+
+   The compressed form is a series of sequences.  Each sequence
+   starts with a token byte, whose high 4 bits give a count of
+   literal bytes and whose low 4 bits give the length of a match
+   minus LZ_MIN_MATCH.  A count of 15 in either half is followed
+   by extra bytes that are added to it, each 255 except the last.
+   Then come the literal bytes themselves, then a 2-byte
+   little-endian offset back into the output from which the match
+   is copied, then the match length's extra bytes.  The last
+   sequence ends after its literals and has no match.
+
+   Matches are found through a table indexed by a hash of the 4
+   bytes at each position, holding the last position where those
+   bytes were seen.  A table miss or a hash collision only costs
+   compression, never correctness, because every candidate is
+   checked against the input. */
+
+/* Shortest match worth encoding. */
+#define LZ_MIN_MATCH 4
+
+/* Farthest match that a 2-byte offset can reach. */
+#define LZ_MAX_OFFSET 65535
+
+/* Reads 4 bytes at P, in any alignment. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return v;
+}
+
+/* Returns the match table index for the 4 bytes at P. */
+static inline size_t
+hash4 (const uint8_t *p)
+{
+  return (read32 (p) * 2654435761u) >> 22;
+}
+
+/* Writes LENGTH, less the part of it that fit in a token, as a
+   run of extra bytes at *OP, which must not pass END.  Returns
+   false if there is no room. */
+static bool
+put_length (uint8_t **op, uint8_t *end, size_t length)
+{
+  if (length < 15)
+    return true;
+  for (length -= 15; ; length -= 255)
+    {
+      if (*op >= end)
+        return false;
+      if (length < 255)
+        {
+          *(*op)++ = length;
+          return true;
+        }
+      *(*op)++ = 255;
+    }
+}
+
+/* Reads a length whose token half was HALF from *IP, which must
+   not pass END, into *LENGTH.  Returns false if the input ends
+   first. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t half,
+            size_t *length)
+{
+  *length = half;
+  if (half < 15)
+    return true;
+  for (;;)
+    {
+      if (*ip >= end)
+        return false;
+      *length += **ip;
+      if (*(*ip)++ != 255)
+        return true;
+    }
+}
+
+/* Writes a sequence of LIT_CNT literals from LIT, followed by a
+   match of MATCH_LEN bytes at OFFSET back unless MATCH_LEN is 0,
+   at *OP, which must not pass END.  Returns false if there is no
+   room. */
+static bool
+put_sequence (uint8_t **op, uint8_t *end, const uint8_t *lit,
+              size_t lit_cnt, size_t offset, size_t match_len)
+{
+  size_t match_code = match_len != 0 ? match_len - LZ_MIN_MATCH : 0;
+  uint8_t *token;
+
+  if (*op >= end)
+    return false;
+  token = (*op)++;
+  *token = ((lit_cnt < 15 ? lit_cnt : 15) << 4
+            | (match_code < 15 ? match_code : 15));
+
+  if (!put_length (op, end, lit_cnt) || (size_t) (end - *op) < lit_cnt)
+    return false;
+  memcpy (*op, lit, lit_cnt);
+  *op += lit_cnt;
+
+  if (match_len != 0)
+    {
+      if (end - *op < 2)
+        return false;
+      *(*op)++ = offset & 0xff;
+      *(*op)++ = offset >> 8;
+      if (!put_length (op, end, match_code))
+        return false;
+    }
+  return true;
+}
+
+/* Compresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes
+   at DST.  TABLE must point to LZ_TABLE_SIZE elements of scratch
+   space.  Returns the size of the compressed data, or 0 if it
+   would not fit in DST_SIZE bytes. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst_, size_t dst_size, uint16_t *table)
+{
+  const uint8_t *src = src_;
+  uint8_t *op = dst_;
+  uint8_t *end = op + dst_size;
+  size_t anchor = 0;
+  size_t i = 0;
+
+  ASSERT (src_size <= LZ_MAX_OFFSET);
+
+  memset (table, 0, LZ_TABLE_SIZE * sizeof *table);
+  while (i + LZ_MIN_MATCH <= src_size)
+    {
+      size_t h = hash4 (src + i);
+      size_t cand = table[h];
+      table[h] = i;
+
+      if (cand < i && read32 (src + cand) == read32 (src + i))
+        {
+          size_t len = LZ_MIN_MATCH;
+          while (i + len < src_size && src[cand + len] == src[i + len])
+            len++;
+          if (!put_sequence (&op, end, src + anchor, i - anchor,
+                             i - cand, len))
+            return 0;
+          i += len;
+          anchor = i;
+        }
+      else
+        i++;
+    }
+
+  if (!put_sequence (&op, end, src + anchor, src_size - anchor, 0, 0))
+    return 0;
+  return op - (uint8_t *) dst_;
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC, produced by
+   lz_compress(), into the DST_SIZE bytes at DST.  Returns the
+   size of the decompressed data, or 0 if SRC is malformed or
+   would not fit. */
+size_t
+lz_decompress (const void *src_, size_t src_size,
+               void *dst_, size_t dst_size)
+{
+  const uint8_t *ip = src_;
+  const uint8_t *ip_end = ip + src_size;
+  uint8_t *dst = dst_;
+  size_t op = 0;
+
+  while (ip < ip_end)
+    {
+      uint8_t token = *ip++;
+      size_t lit_cnt, match_len, offset;
+
+      if (!get_length (&ip, ip_end, token >> 4, &lit_cnt)
+          || (size_t) (ip_end - ip) < lit_cnt
+          || dst_size - op < lit_cnt)
+        return 0;
+      memcpy (dst + op, ip, lit_cnt);
+      ip += lit_cnt;
+      op += lit_cnt;
+      if (ip == ip_end)
+        break;
+
+      if (ip_end - ip < 2)
+        return 0;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (!get_length (&ip, ip_end, token & 15, &match_len))
+        return 0;
+      match_len += LZ_MIN_MATCH;
+      if (offset == 0 || offset > op || dst_size - op < match_len)
+        return 0;
+
+      /* The match may overlap the bytes it produces, so copy a
+         byte at a time. */
+      for (; match_len > 0; match_len--, op++)
+        dst[op] = dst[op - offset];
+    }
+  return op;
+}
@@ -0,0 +1,18 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fast LZ77-class compression of buffers up to 64 kB. */
+
+/* Number of entries in the match table that lz_compress() needs
+   as scratch space.  The table is too big for a kernel stack. */
+#define LZ_TABLE_SIZE 1024
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, uint16_t *table);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
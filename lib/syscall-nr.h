@@ -28,7 +28,14 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_VMSTAT,                 /* Get virtual memory statistics. */
+    SYS_SBRK,                   /* Move the end of the heap. */
+    SYS_CHECKPOINT,             /* Save this process to a file. */
+    SYS_RESTORE                 /* Start a process saved to a file. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,312 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A malloc() for user programs, built on sbrk().
+
+   As in the kernel's malloc(), each request is rounded up to a
+   power of 2 between 16 bytes and 1 kB and served from the free
+   list of the "descriptor" for blocks of that size.  When a
+   descriptor's free list runs dry, ARENA_BATCH pages are taken
+   from the end of the heap with a single sbrk() call.  Each page
+   becomes an "arena" with a small header, and every block of
+   every new arena goes onto the free list at once, so the system
+   call is paid for only once per batch of pages.
+
+   A user process has a single thread, so nothing is locked, and
+   allocating or freeing a small block is just popping or pushing
+   a free list.  Freed small blocks stay on their descriptor's
+   free list for reuse, because sbrk() can only give back memory
+   at the end of the heap.
+
+   Requests bigger than 1 kB get whole pages, with the arena
+   header at the start of the first one.  A freed big block is
+   returned with sbrk() if it is at the end of the heap and
+   otherwise kept on a list, from which later big requests are
+   served first fit. */
+
+/* Size of a page. */
+#define PAGE_SIZE 4096
+
+/* Number of arenas a descriptor takes from the heap at once. */
+#define ARENA_BATCH 4
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Free block. */
+struct block
+  {
+    struct block *next;         /* Next free block. */
+  };
+
+/* Descriptor. */
+struct desc
+  {
+    size_t block_size;          /* Size of each element in bytes. */
+    size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    struct block *free_list;    /* Free blocks. */
+  };
+
+/* Arena. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning descriptor, null for big block. */
+    size_t page_cnt;            /* Big block: number of pages. */
+    struct arena *next;         /* Big block: next free big block. */
+  };
+
+/* Our set of descriptors. */
+static struct desc descs[8];    /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors. */
+
+/* Free big blocks. */
+static struct arena *free_big;
+
+static void init_descs (void);
+static bool refill (struct desc *);
+static void *malloc_big (size_t size);
+static void free_big_block (struct arena *);
+static void *get_pages (size_t page_cnt);
+static struct arena *block_to_arena (void *);
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct desc *d;
+  struct block *b;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  if (desc_cnt == 0)
+    init_descs ();
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + desc_cnt)
+    return malloc_big (size);
+
+  if (d->free_list == NULL && !refill (d))
+    return NULL;
+  b = d->free_list;
+  d->free_list = b->next;
+  return b;
+}
+
+/* Allocates and returns A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (size < a || size < b)
+    return NULL;
+
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+  return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.  If successful, returns the new
+   block; on failure, returns a null pointer.  A call with null
+   OLD_BLOCK is equivalent to malloc(NEW_SIZE).  A call with zero
+   NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  struct arena *a;
+  size_t old_size;
+  void *new_block;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  a = block_to_arena (old_block);
+  old_size = (a->desc != NULL
+              ? a->desc->block_size
+              : a->page_cnt * PAGE_SIZE - sizeof *a);
+  if (new_size <= old_size)
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block, old_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct arena *a;
+  struct block *b;
+
+  if (p == NULL)
+    return;
+
+  a = block_to_arena (p);
+  if (a->desc == NULL)
+    {
+      free_big_block (a);
+      return;
+    }
+
+  b = p;
+  b->next = a->desc->free_list;
+  a->desc->free_list = b;
+}
+
+/* Initializes the descriptors. */
+static void
+init_descs (void)
+{
+  size_t block_size;
+
+  for (block_size = 16; block_size < PAGE_SIZE / 2; block_size *= 2)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = block_size;
+      d->blocks_per_arena = (PAGE_SIZE - sizeof (struct arena)) / block_size;
+      d->free_list = NULL;
+    }
+}
+
+/* Adds a batch of new arenas' worth of blocks to D's free list,
+   or a single arena's if the heap cannot grow by a whole batch.
+   Returns false if the heap cannot grow at all. */
+static bool
+refill (struct desc *d)
+{
+  size_t arena_cnt = ARENA_BATCH;
+  uint8_t *pages;
+  size_t i, j;
+
+  pages = get_pages (arena_cnt);
+  if (pages == NULL)
+    {
+      arena_cnt = 1;
+      pages = get_pages (arena_cnt);
+      if (pages == NULL)
+        return false;
+    }
+
+  /* Push the blocks in reverse, so that they are handed out in
+     address order. */
+  for (i = arena_cnt; i-- > 0; )
+    {
+      struct arena *a = (struct arena *) (pages + i * PAGE_SIZE);
+      uint8_t *blocks = (uint8_t *) (a + 1);
+
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->page_cnt = 1;
+      a->next = NULL;
+      for (j = d->blocks_per_arena; j-- > 0; )
+        {
+          struct block *b = (struct block *) (blocks + j * d->block_size);
+          b->next = d->free_list;
+          d->free_list = b;
+        }
+    }
+  return true;
+}
+
+/* Returns a block of at least SIZE bytes too big for any
+   descriptor, reusing a free big block if one is big enough.
+   Returns a null pointer if memory is not available. */
+static void *
+malloc_big (size_t size)
+{
+  struct arena **ap, *a;
+  size_t page_cnt;
+
+  if (size > SIZE_MAX / 2)
+    return NULL;
+  page_cnt = DIV_ROUND_UP (size + sizeof *a, PAGE_SIZE);
+
+  for (ap = &free_big; *ap != NULL; ap = &(*ap)->next)
+    if ((*ap)->page_cnt >= page_cnt)
+      {
+        a = *ap;
+        *ap = a->next;
+        return a + 1;
+      }
+
+  a = get_pages (page_cnt);
+  if (a == NULL)
+    return NULL;
+  a->magic = ARENA_MAGIC;
+  a->desc = NULL;
+  a->page_cnt = page_cnt;
+  a->next = NULL;
+  return a + 1;
+}
+
+/* Frees big block A: shrinks the heap if A is at its end,
+   otherwise keeps A for reuse. */
+static void
+free_big_block (struct arena *a)
+{
+  intptr_t size = a->page_cnt * PAGE_SIZE;
+
+  if ((uint8_t *) a + size == sbrk (0))
+    sbrk (-size);
+  else
+    {
+      a->next = free_big;
+      free_big = a;
+    }
+}
+
+/* Extends the heap by PAGE_CNT pages, starting on a page
+   boundary, and returns the first new page.  Returns a null
+   pointer if the heap cannot grow that far. */
+static void *
+get_pages (size_t page_cnt)
+{
+  uintptr_t end = (uintptr_t) sbrk (0);
+  size_t pad = ROUND_UP (end, PAGE_SIZE) - end;
+  uint8_t *p = sbrk (pad + page_cnt * PAGE_SIZE);
+
+  return p != (void *) -1 ? p + pad : NULL;
+}
+
+/* Returns the arena that block P is in. */
+static struct arena *
+block_to_arena (void *p)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) p & ~(PAGE_SIZE - 1));
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  return a;
+}
@@ -182,3 +182,40 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+bool
+vmstat (struct vmstat *st)
+{
+  return syscall1 (SYS_VMSTAT, st);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+int
+brk (void *end)
+{
+  char *old = sbrk (0);
+  return sbrk ((char *) end - old) != (void *) -1 ? 0 : -1;
+}
+
+int
+checkpoint (const char *file)
+{
+  return syscall1 (SYS_CHECKPOINT, file);
+}
+
+pid_t
+restore (const char *file)
+{
+  return (pid_t) syscall1 (SYS_RESTORE, file);
+}
@@ -2,7 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
+#include <vmstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +47,12 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+bool vmstat (struct vmstat *);
+void *sbrk (intptr_t increment);
+int brk (void *end);
+int checkpoint (const char *file);
+pid_t restore (const char *file);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,19 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory statistics for a process, as returned by the
+   vmstat system call. */
+struct vmstat
+  {
+    long long page_faults;        /* Page faults taken. */
+    long long fault_around_pages; /* Pages mapped around faults. */
+    long long swap_ins;           /* Pages read in from swap. */
+    long long swap_outs;          /* Pages written out to swap. */
+    long long evictions;          /* Pages evicted from frames. */
+    long long resident_pages;     /* Pages now resident in frames. */
+    long long swapped_pages;      /* Pages now in swap. */
+    long long page_tables;        /* Page tables now allocated. */
+    long long ticks;              /* Timer ticks since boot. */
+  };
+
+#endif /* lib/vmstat.h */
@@ -0,0 +1,52 @@
+/* Checks that malloc() keeps an arena that has become empty,
+   instead of giving it back to the page allocator, and hands out
+   its blocks again on the next allocation. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+
+/* Largest size that malloc() serves from arenas. */
+#define BLOCK_SIZE 1024
+
+/* Most blocks to allocate while looking for a new arena. */
+#define MAX_BLOCKS 32
+
+void
+test_malloc_cache (void)
+{
+  void *blocks[MAX_BLOCKS];
+  size_t free_cnt = 0;
+  void *a, *b;
+  int i, cnt;
+
+  /* Allocate blocks until one of them needs a new arena.  That
+     arena's other blocks are then free, so freeing this one
+     leaves the arena empty. */
+  for (cnt = 0; cnt < MAX_BLOCKS; cnt++)
+    {
+      free_cnt = palloc_free_cnt (0);
+      a = malloc (BLOCK_SIZE);
+      if (a == NULL)
+        fail ("malloc failed");
+      if (palloc_free_cnt (0) < free_cnt)
+        break;
+      blocks[cnt] = a;
+    }
+  if (cnt == MAX_BLOCKS)
+    fail ("no new arena after %d blocks", MAX_BLOCKS);
+
+  free (a);
+  if (palloc_free_cnt (0) != free_cnt - 1)
+    fail ("empty arena was given back to the page allocator");
+
+  b = malloc (BLOCK_SIZE);
+  if (b != a || palloc_free_cnt (0) != free_cnt - 1)
+    fail ("empty arena was not reused");
+
+  free (b);
+  for (i = 0; i < cnt; i++)
+    free (blocks[i]);
+  pass ();
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-cache) begin
+(malloc-cache) PASS
+(malloc-cache) end
+EOF
+pass;
@@ -33,6 +33,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_malloc_cache;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,65 @@
+/* Fills memory and the heap and opens a file, saves the process
+   to a checkpoint image, then changes all of them and restores
+   the image as a new process, which must see the memory, heap,
+   and file position as they were saved. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+static char zeros[SIZE];
+
+void
+test_main (void)
+{
+  char line[16];
+  char *heap;
+  int handle, state;
+  pid_t child;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+  heap = malloc (5000);
+  if (heap == NULL)
+    fail ("malloc failed");
+  strlcpy (heap, "heap data", 5000);
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  seek (handle, 10);
+
+  state = checkpoint ("image");
+  if (state == 1)
+    {
+      msg ("restored");
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != (char) (i % 251))
+          fail ("byte %zu of data is wrong", i);
+      for (i = 0; i < SIZE; i++)
+        if (zeros[i] != 0)
+          fail ("byte %zu of zeros is wrong", i);
+      if (strcmp (heap, "heap data"))
+        fail ("heap is wrong");
+      if (read (handle, line, 5) != 5 || memcmp (line, sample + 10, 5))
+        fail ("file position is wrong");
+      msg ("memory, heap, and file position restored");
+      exit (81);
+    }
+  CHECK (state == 0, "checkpoint");
+
+  memset (buf, 0, sizeof buf);
+  strlcpy (heap, "changed", 5000);
+  seek (handle, 0);
+
+  msg ("restore");
+  child = restore ("image");
+  if (child == -1)
+    fail ("restore failed");
+  CHECK (wait (child) == 81, "wait for restored process");
+  CHECK (buf[1] == 0 && !strcmp (heap, "changed"), "own memory unchanged");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ckpt-restore) begin
+(ckpt-restore) open "sample.txt"
+(ckpt-restore) checkpoint
+(ckpt-restore) restore
+(ckpt-restore) restored
+(ckpt-restore) memory, heap, and file position restored
+ckpt-restore: exit(81)
+(ckpt-restore) wait for restored process
+(ckpt-restore) own memory unchanged
+(ckpt-restore) end
+ckpt-restore: exit(0)
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Runs as a dynamically linked program, which the kernel links
+   with libc.so when it loads it.  Calls into the library, keeps
+   data in the library's heap, and forks a child that does the
+   same, which reads the library's pages from its own copy of the
+   library. */
+
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char buf[64];
+  char *copy;
+  pid_t child;
+
+  snprintf (buf, sizeof buf, "%s %d", "shared", 42);
+  CHECK (!strcmp (buf, "shared 42"), "call into the library");
+
+  copy = malloc (strlen (buf) + 1);
+  CHECK (copy != NULL, "malloc");
+  strlcpy (copy, buf, strlen (buf) + 1);
+
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: %s", copy);
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork failed");
+
+  CHECK (wait (child) == 81, "wait for child");
+  CHECK (!strcmp (copy, "shared 42"), "parent's copy intact");
+  free (copy);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dyn-link) begin
+(dyn-link) call into the library
+(dyn-link) malloc
+(dyn-link) child: shared 42
+dyn-link: exit(81)
+(dyn-link) wait for child
+(dyn-link) parent's copy intact
+(dyn-link) end
+dyn-link: exit(0)
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Reads one byte from each page of a 64 kB read-only array in
+   the executable and verifies, through the vmstat system call,
+   that mapping neighbouring pages on a fault saved most of the
+   page faults. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 16
+
+static const char buf[PAGE_CNT * 4096] = {1};
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  long long faults;
+  size_t i;
+  int sum = 0;
+
+  CHECK (vmstat (&before), "vmstat before");
+  for (i = 0; i < sizeof buf; i += 4096)
+    sum += *(volatile const char *) &buf[i];
+  CHECK (vmstat (&after), "vmstat after");
+
+  if (sum != 1)
+    fail ("sum of first bytes is %d, expected 1", sum);
+  faults = after.page_faults - before.page_faults;
+  if (faults >= PAGE_CNT / 2)
+    fail ("%lld page faults reading %d pages", faults, PAGE_CNT);
+  msg ("fewer than %d page faults", PAGE_CNT / 2);
+}
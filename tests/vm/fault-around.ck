@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fault-around) begin
+(fault-around) vmstat before
+(fault-around) vmstat after
+(fault-around) fewer than 8 page faults
+(fault-around) end
+fault-around: exit(0)
+EOF
+pass;
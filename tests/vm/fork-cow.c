@@ -0,0 +1,42 @@
+/* Forks a process with 1 MB of initialized data and has the
+   child overwrite it, then verifies that the child saw the
+   parent's data and that the parent does not see the child's
+   writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  msg ("initialize");
+  memset (buf, 0x5a, sizeof buf);
+
+  child = fork ();
+  if (child == 0)
+    {
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 0x5a)
+          fail ("child: byte %zu != 0x5a", i);
+      memset (buf, 0xa5, sizeof buf);
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork failed");
+
+  CHECK (wait (child) == 81, "wait for child");
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu != 0x5a", i);
+}
@@ -0,0 +1,83 @@
+/* Grows and shrinks the heap with sbrk(), then allocates blocks
+   of many sizes with malloc(), fills each with its own pattern,
+   frees and reallocates some of them, and verifies that no block
+   was overwritten by another. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 512
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Returns the size of block I. */
+static size_t
+block_size (size_t i)
+{
+  return i % 7 == 0 ? 3000 + i * 5 : 1 + (i * 37) % 700;
+}
+
+/* Checks that block I holds its pattern. */
+static void
+check_block (size_t i)
+{
+  size_t j;
+
+  for (j = 0; j < sizes[i]; j++)
+    if (blocks[i][j] != (char) (i + j))
+      fail ("block %zu byte %zu is corrupt", i, j);
+}
+
+void
+test_main (void)
+{
+  char *start, *p;
+  size_t i;
+
+  msg ("sbrk");
+  start = sbrk (0);
+  p = sbrk (3 * 4096);
+  CHECK (p == start, "sbrk returns the old end of the heap");
+  memset (p, 'x', 3 * 4096);
+  CHECK (sbrk (-3 * 4096) == start + 3 * 4096, "heap shrinks");
+  CHECK (sbrk (0) == start, "heap is back where it started");
+
+  msg ("malloc");
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      size_t j;
+
+      sizes[i] = block_size (i);
+      blocks[i] = malloc (sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("malloc of %zu bytes failed", sizes[i]);
+      for (j = 0; j < sizes[i]; j++)
+        blocks[i][j] = i + j;
+    }
+
+  msg ("free and realloc");
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    {
+      free (blocks[i]);
+      blocks[i] = NULL;
+    }
+  for (i = 1; i < BLOCK_CNT; i += 4)
+    {
+      size_t j;
+
+      blocks[i] = realloc (blocks[i], sizes[i] * 2);
+      if (blocks[i] == NULL)
+        fail ("realloc of block %zu failed", i);
+      for (j = sizes[i]; j < sizes[i] * 2; j++)
+        blocks[i][j] = i + j;
+      sizes[i] *= 2;
+    }
+
+  msg ("verify");
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    check_block (i);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(heap-malloc) begin
+(heap-malloc) sbrk
+(heap-malloc) sbrk returns the old end of the heap
+(heap-malloc) heap shrinks
+(heap-malloc) heap is back where it started
+(heap-malloc) malloc
+(heap-malloc) free and realloc
+(heap-malloc) verify
+(heap-malloc) end
+heap-malloc: exit(0)
+EOF
+pass;
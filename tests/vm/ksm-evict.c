@@ -0,0 +1,89 @@
+/* Fills more than 255 pages with the same bytes, a few at a time,
+   and gives the merging thread time to merge each batch into one
+   frame, so that the process never needs more frames than its
+   user pool has.  Then writes enough other pages to evict that
+   frame, which puts every one of its pages into a single swap
+   slot, and verifies that all of them read back intact.
+
+   Run with -ksm, to merge pages, and -ul, to make the user pool
+   smaller than IDENT_CNT pages. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Identical pages, written BATCH_CNT at a time. */
+#define IDENT_CNT 288
+#define BATCH_CNT 32
+
+/* Pages written to push the identical pages out. */
+#define OTHER_CNT 256
+
+/* Timer ticks to wait for a batch to be merged: long enough for
+   several passes of the merging thread. */
+#define MERGE_TICKS 40
+
+#define PAGE_SIZE 4096
+
+static char ident[IDENT_CNT * PAGE_SIZE];
+static char other[OTHER_CNT * PAGE_SIZE];
+
+/* Spins until TICKS timer ticks have passed. */
+static void
+wait_ticks (long long ticks)
+{
+  struct vmstat v;
+  long long start;
+
+  vmstat (&v);
+  start = v.ticks;
+  do
+    vmstat (&v);
+  while (v.ticks - start < ticks);
+}
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  size_t i, j;
+
+  msg ("write identical pages");
+  CHECK (vmstat (&before), "vmstat before");
+  for (i = 0; i < IDENT_CNT; i += BATCH_CNT)
+    {
+      for (j = i; j < i + BATCH_CNT; j++)
+        memset (ident + j * PAGE_SIZE, 0x5a, PAGE_SIZE);
+      wait_ticks (MERGE_TICKS);
+    }
+  CHECK (vmstat (&after), "vmstat after identical pages");
+  CHECK (after.evictions == before.evictions,
+         "identical pages merged without eviction");
+
+  msg ("write other pages");
+  for (j = 0; j < 2; j++)
+    for (i = 0; i < OTHER_CNT; i++)
+      {
+        memset (other + i * PAGE_SIZE, i, PAGE_SIZE);
+        *(size_t *) (other + i * PAGE_SIZE) = i;
+      }
+  CHECK (vmstat (&after), "vmstat after other pages");
+  CHECK (after.resident_pages < IDENT_CNT, "merged frame evicted");
+
+  msg ("verify identical pages");
+  for (i = 0; i < sizeof ident; i++)
+    if (ident[i] != 0x5a)
+      fail ("byte %zu of identical pages is %d", i, ident[i]);
+
+  msg ("verify other pages");
+  for (i = 0; i < OTHER_CNT; i++)
+    {
+      char *page = other + i * PAGE_SIZE;
+      if (*(size_t *) page != i)
+        fail ("page %zu of other pages is page %zu", i, *(size_t *) page);
+      for (j = sizeof (size_t); j < PAGE_SIZE; j++)
+        if (page[j] != (char) i)
+          fail ("byte %zu of other page %zu is %d", j, i, page[j]);
+    }
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ksm-evict) begin
+(ksm-evict) write identical pages
+(ksm-evict) vmstat before
+(ksm-evict) vmstat after identical pages
+(ksm-evict) identical pages merged without eviction
+(ksm-evict) write other pages
+(ksm-evict) vmstat after other pages
+(ksm-evict) merged frame evicted
+(ksm-evict) verify identical pages
+(ksm-evict) verify other pages
+(ksm-evict) end
+ksm-evict: exit(0)
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Reads all of a 1 MB array in bss, which should then share a
+   single zero page, so that the read pass faults on every page
+   but leaves the process with hardly any more resident pages.
+   Then writes to every fourth page of it, which must give each
+   of those pages a frame of its own, and verifies that the
+   writes went to private copies and the other pages still read
+   as zeros. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 256
+
+/* Most resident pages the read pass may add, for the stack and
+   the page that buf may share with initialized data. */
+#define READ_SLACK 8
+
+static char buf[PAGE_CNT * 4096];
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  size_t i;
+
+  msg ("read pass");
+  CHECK (vmstat (&before), "vmstat before read pass");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+  CHECK (vmstat (&after), "vmstat after read pass");
+  CHECK (after.page_faults - before.page_faults >= PAGE_CNT - 1,
+         "read pass faulted on every page");
+  CHECK (after.resident_pages - before.resident_pages < READ_SLACK,
+         "read pass mapped the zero page");
+
+  msg ("write pass");
+  before = after;
+  for (i = 0; i < PAGE_CNT; i += 4)
+    buf[i * 4096 + i] = i + 1;
+  CHECK (vmstat (&after), "vmstat after write pass");
+  CHECK (after.resident_pages - before.resident_pages >= PAGE_CNT / 4,
+         "write pass gave each written page a frame");
+
+  msg ("verify pass");
+  for (i = 0; i < sizeof buf; i++)
+    {
+      size_t page = i / 4096;
+      char expected = page % 4 == 0 && i % 4096 == page ? page + 1 : 0;
+      if (buf[i] != expected)
+        fail ("byte %zu is %d, expected %d", i, buf[i], expected);
+    }
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(page-zero) begin
+(page-zero) read pass
+(page-zero) vmstat before read pass
+(page-zero) vmstat after read pass
+(page-zero) read pass faulted on every page
+(page-zero) read pass mapped the zero page
+(page-zero) write pass
+(page-zero) vmstat after write pass
+(page-zero) write pass gave each written page a frame
+(page-zero) verify pass
+(page-zero) end
+page-zero: exit(0)
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Grows the heap by more than 8 MB, touches one page in each of
+   three 4 MB regions of it that nothing else maps, and verifies,
+   through the vmstat system call, that the process gained a page
+   table for each and lost them again when it shrank the heap. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define REGION (4 * 1024 * 1024)
+#define REGION_CNT 3
+
+void
+test_main (void)
+{
+  struct vmstat before, touched, after;
+  uintptr_t brk, first;
+  size_t size;
+  int i;
+
+  brk = (uintptr_t) sbrk (0);
+  first = (brk / REGION + 2) * REGION;
+  size = first + REGION_CNT * REGION - brk;
+  CHECK (sbrk (size) != (void *) -1, "grow heap");
+
+  CHECK (vmstat (&before), "vmstat before");
+  for (i = 0; i < REGION_CNT; i++)
+    *(volatile char *) (first + i * REGION) = i;
+  CHECK (vmstat (&touched), "vmstat after touching");
+  CHECK (touched.page_tables == before.page_tables + REGION_CNT,
+         "one page table per region touched");
+
+  CHECK (sbrk (-(intptr_t) size) != (void *) -1, "shrink heap");
+  CHECK (vmstat (&after), "vmstat after shrinking");
+  CHECK (after.page_tables == before.page_tables,
+         "page tables freed");
+}
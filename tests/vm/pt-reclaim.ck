@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pt-reclaim) begin
+(pt-reclaim) grow heap
+(pt-reclaim) vmstat before
+(pt-reclaim) vmstat after touching
+(pt-reclaim) one page table per region touched
+(pt-reclaim) shrink heap
+(pt-reclaim) vmstat after shrinking
+(pt-reclaim) page tables freed
+(pt-reclaim) end
+pt-reclaim: exit(0)
+EOF
+pass;
@@ -5,4 +5,10 @@
 #define FLAG_MBS  0x00000002    /* Must be set. */
 #define FLAG_IF   0x00000200    /* Interrupt Flag. */
 
+/* CR4 Register. */
+#define CR4_PSE   0x00000010    /* Page Size Extensions. */
+
+/* CPUID feature flags, in EDX for EAX=1. */
+#define CPUID_PSE 0x00000008    /* Page Size Extensions. */
+
 #endif /* threads/flags.h */
@@ -15,6 +15,7 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -22,6 +23,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,6 +39,12 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -59,6 +67,7 @@ static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -98,6 +107,7 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  vmalloc_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -113,6 +123,9 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+#ifdef VM
+  frame_init ();
+#endif
 #endif
 
   /* Start thread scheduler and enable interrupts. */
@@ -126,6 +139,14 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  swap_init ();
+  frame_start_pageout ();
+  frame_start_merging ();
+#endif
+#ifdef USERPROG
+  process_start_reaper ();
+#endif
 
   printf ("Boot complete.\n");
 
@@ -154,13 +175,20 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports 4 MB pages, each whole 4 MB of RAM is
+   mapped with a single large page, which saves page tables and
+   TLB entries.  The 4 MB that hold the kernel's text, which is
+   read-only, and any partial 4 MB at the end of RAM still use
+   4 kB pages. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool pse = cpu_has_pse ();
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -172,6 +200,14 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0 && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large_kernel (vaddr, true);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -181,6 +217,15 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* Large page PDEs are honored only with CR4.PSE set.  See
+     [IA32-v3a] 3.7.3 "Mixing 4-KByte and 4-MByte Pages". */
+  if (pse)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0; orl %1, %0; movl %0, %%cr4"
+                    : "=&r" (cr4) : "i" (CR4_PSE));
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -189,6 +234,18 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages, according to the
+   PSE feature flag returned by CPUID.  See [IA32-v2a] "CPUID--CPU
+   Identification". */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -251,6 +308,16 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-stack"))
+        page_stack_limit = atoi (value);
+      else if (!strcmp (name, "-fault-around"))
+        page_fault_around = atoi (value);
+      else if (!strcmp (name, "-zswap"))
+        zswap_max_pages = atoi (value);
+      else if (!strcmp (name, "-rss"))
+        page_rss_limit = atoi (value);
+      else if (!strcmp (name, "-ksm"))
+        frame_merge_pages = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -260,6 +327,12 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-colors"))
+        palloc_page_colors = atoi (value);
+#ifndef VM
+      else if (!strcmp (name, "-large-pages"))
+        process_large_pages = true;
+#endif
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -376,12 +449,21 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -stack=COUNT       Limit user stacks to COUNT pages.\n"
+          "  -fault-around=COUNT  Map up to COUNT file pages per page fault.\n"
+          "  -zswap=COUNT       Compress swapped pages into COUNT pages of RAM.\n"
+          "  -rss=COUNT         Limit each process to COUNT resident pages.\n"
+          "  -ksm=COUNT         Scan COUNT frames per pass for pages to merge.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -colors=N          Color user pages with N cache colors.\n"
+#ifndef VM
+          "  -large-pages       Load aligned 4 MB of programs into large pages.\n"
+#endif
 #endif
           );
   shutdown_power_off ();
@@ -9,6 +9,10 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef VM
+#include "userprog/gdt.h"
+#include "vm/oom.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -386,6 +390,13 @@ intr_handler (struct intr_frame *frame)
       if (yield_on_return)
         thread_yield ();
     }
+
+#ifdef VM
+  /* A process killed to free memory exits on its way back to
+     user mode. */
+  if (frame->cs == SEL_UCSEG)
+    oom_exit_if_killed ();
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -8,6 +8,7 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -24,15 +25,22 @@
    list.  Then we return one of the new blocks.
 
    When we free a block, we add it to its descriptor's free list.
-   But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   If the arena that the block was in now has no in-use blocks,
+   we keep it around, up to MAX_EMPTY_ARENAS per descriptor, to
+   save a trip through the page allocator the next time the
+   descriptor runs dry.  Beyond that limit, or when the page
+   allocator's shrinker asks for memory back, we remove all of an
+   empty arena's blocks from the free list and give the arena
+   back to the page allocator.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If the
+   kernel pool is too fragmented to supply enough physically
+   contiguous pages, we fall back to vmalloc, which only needs
+   the pages to be virtually contiguous. */
 
 /* Descriptor. */
 struct desc
@@ -40,9 +48,13 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_cnt;           /* Number of arenas with no blocks in use. */
     struct lock lock;           /* Lock. */
   };
 
+/* Maximum number of empty arenas kept per descriptor. */
+#define MAX_EMPTY_ARENAS 8
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -66,6 +78,12 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void free_arena (struct desc *, struct arena *);
+static size_t shrink_arenas (enum palloc_flags, size_t page_cnt);
+
+/* Gives cached empty arenas back to the page allocator. */
+static struct shrinker arena_shrinker = {"malloc", shrink_arenas, 0, 0,
+                                         {NULL, NULL}};
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,8 +98,11 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->empty_cnt = 0;
       lock_init (&d->lock);
     }
+
+  palloc_register_shrinker (&arena_shrinker);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -108,6 +129,8 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL)
+        a = vmalloc_get_pages (0, page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -143,12 +166,17 @@ malloc (size_t size)
           struct block *b = arena_to_block (a, i);
           list_push_back (&d->free_list, &b->free_elem);
         }
+      d->empty_cnt++;
     }
 
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
-  a->free_cnt--;
+  if (a->free_cnt-- == d->blocks_per_arena)
+    {
+      ASSERT (d->empty_cnt > 0);
+      d->empty_cnt--;
+    }
   lock_release (&d->lock);
   return b;
 }
@@ -238,18 +266,15 @@ free (void *p)
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
+          /* If the arena is now entirely unused, cache it, or
+             free it if the cache is full. */
           if (++a->free_cnt >= d->blocks_per_arena)
             {
-              size_t i;
-
               ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++)
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              if (d->empty_cnt < MAX_EMPTY_ARENAS)
+                d->empty_cnt++;
+              else
+                free_arena (d, a);
             }
 
           lock_release (&d->lock);
@@ -257,12 +282,80 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          if (is_vmalloc_vaddr (a))
+            vmalloc_free_pages (a);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Removes the blocks of arena A, which must have no blocks in
+   use, from descriptor D's free list and gives A back to the page
+   allocator.  D's lock must be held. */
+static void
+free_arena (struct desc *d, struct arena *a)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+  ASSERT (a->free_cnt == d->blocks_per_arena);
+
+  for (i = 0; i < d->blocks_per_arena; i++)
+    {
+      struct block *b = arena_to_block (a, i);
+      list_remove (&b->free_elem);
+    }
+  palloc_free_page (a);
+}
+
+/* Shrinker callback.  Frees up to PAGE_CNT cached empty arenas.
+   Descriptors whose lock is busy, possibly because the thread
+   that ran out of memory is inside malloc() itself, are
+   skipped. */
+static size_t
+shrink_arenas (enum palloc_flags flags, size_t page_cnt)
+{
+  struct desc *d;
+  size_t freed = 0;
+
+  /* Arenas come from the kernel pool only. */
+  if (flags & PAL_USER)
+    return 0;
+
+  for (d = descs; d < descs + desc_cnt && freed < page_cnt; d++)
+    {
+      struct list_elem *e;
+
+      if (lock_held_by_current_thread (&d->lock)
+          || !lock_try_acquire (&d->lock))
+        continue;
+
+      e = list_begin (&d->free_list);
+      while (d->empty_cnt > 0 && freed < page_cnt
+             && e != list_end (&d->free_list))
+        {
+          struct block *b = list_entry (e, struct block, free_elem);
+          struct arena *a = block_to_arena (b);
+
+          if (a->free_cnt == d->blocks_per_arena)
+            {
+              /* Restart the scan, since freeing the arena takes
+                 E and its neighbors off the list. */
+              free_arena (d, a);
+              d->empty_cnt--;
+              freed++;
+              e = list_begin (&d->free_list);
+            }
+          else
+            e = list_next (e);
+        }
+      lock_release (&d->lock);
+    }
+  return freed;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,22 +24,89 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   The split is only a starting point.  When a pool runs out, it
+   borrows a chunk of PAL_CHUNK_PAGES contiguous free pages (or
+   more, for a larger request) from the other pool, as long as the
+   lender keeps at least half of its initial size and the user
+   pool stays within the user page limit.  Pages never move back
+   on their own; a pool that later runs short simply borrows in
+   the other direction.  To make this possible, both pools' used
+   maps span all of free memory, with pages owned by the other
+   pool marked as in use, and a separate map records which pool
+   owns each page.
+
+   Optionally, pages can be "colored".  A physical page's color
+   is its page number modulo palloc_page_colors, which is chosen
+   so that pages of different colors fall into different sets of
+   a physically indexed CPU cache.  palloc_get_colored_page()
+   looks for a free page whose color matches that of the virtual
+   page it will be mapped at, so that consecutive virtual pages of
+   a process get consecutive colors and do not evict each other
+   from the cache.
+
+   Subsystems that cache pages they could live without register a
+   "shrinker".  When a pool cannot satisfy a request, the
+   shrinkers are asked to give pages back and the request is
+   retried, so that a pool only counts as exhausted once every
+   cache has been drained. */
+
+/* Number of pages lent from one pool to the other at a time. */
+#define PAL_CHUNK_PAGES 64
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
-    uint8_t *base;                      /* Base of pool. */
+    uint8_t *base;                      /* Base of free memory. */
+    const char *name;                   /* Name, for statistics. */
+
+    /* Pages owned, and bounds on lending and borrowing.  Changed
+       only with both pools' locks held. */
+    size_t page_cnt;                    /* Pages currently owned. */
+    size_t min_pages;                   /* Never lend below this. */
+    size_t max_pages;                   /* Never borrow above this. */
+    size_t borrowed_chunks;             /* Chunks borrowed so far. */
+    size_t lent_chunks;                 /* Chunks lent so far. */
+
+    /* Usage statistics.  Updated with interrupts off, because
+       pages are freed from the scheduler. */
+    size_t used_cnt;                    /* Pages allocated. */
+    size_t peak_used;                   /* High watermark of used_cnt. */
+    size_t min_free;                    /* Low watermark of free pages. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
-static void init_pool (struct pool *, void *base, size_t page_cnt,
-                       const char *name);
+/* Pages owned by the user pool.  All others belong to the kernel
+   pool. */
+static struct bitmap *user_map;
+
+/* Number of page colors, or 0 if page coloring is disabled.
+   Controlled by kernel command-line option "-colors=N". */
+size_t palloc_page_colors;
+
+/* Colored allocations that found a page of the wanted color, and
+   those that had to settle for another. */
+static long long color_hits, color_misses;
+
+/* Registered shrinkers. */
+static struct list shrinkers;
+
+/* Held while shrinkers run.  Serializes them, and keeps a
+   shrinker that ends up back in the allocator from recursing. */
+static struct lock shrink_lock;
+
+static void init_pool (struct pool *, void **bm_buf, void *base,
+                       size_t first_page, size_t page_cnt,
+                       size_t total_pages, const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void count_pages (struct pool *, size_t alloc_cnt, size_t free_cnt);
+static bool borrow_pages (struct pool *, size_t page_cnt);
+static bool shrink_caches (enum palloc_flags, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -49,24 +117,49 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_start = ptov (1024 * 1024);
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
+  size_t user_pages, kernel_pages;
+  size_t bm_pages;
+  void *bm_buf;
+
+  /* We'll put the used maps of both pools, plus the ownership
+     map, at the start of free memory.  Each covers every page.
+     Calculate the space needed and subtract it from the free
+     pages. */
+  bm_pages = DIV_ROUND_UP (3 * bitmap_buf_size (free_pages), PGSIZE);
+  if (bm_pages >= free_pages)
+    PANIC ("Not enough memory for page allocator bitmaps.");
+  free_pages -= bm_pages;
+  bm_buf = free_start;
+  free_start += bm_pages * PGSIZE;
+
+  user_pages = free_pages / 2;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
   kernel_pages = free_pages - user_pages;
 
+  list_init (&shrinkers);
+  lock_init (&shrink_lock);
+
   /* Give half of memory to kernel, half to user. */
-  init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
-  init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
-             user_pages, "user pool");
+  user_map = bitmap_create_in_buf (free_pages, bm_buf,
+                                   bitmap_buf_size (free_pages));
+  bm_buf = (uint8_t *) bm_buf + bitmap_buf_size (free_pages);
+  bitmap_set_multiple (user_map, kernel_pages, user_pages, true);
+  init_pool (&kernel_pool, &bm_buf, free_start, 0, kernel_pages,
+             free_pages, "kernel pool");
+  init_pool (&user_pool, &bm_buf, free_start, kernel_pages, user_pages,
+             free_pages, "user pool");
+  user_pool.max_pages = (user_page_limit < free_pages
+                         ? user_page_limit : free_pages);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   available even after asking the registered shrinkers to give
+   pages back, returns a null pointer, unless PAL_ASSERT is set
+   in FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
@@ -77,9 +170,21 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  for (;;)
+    {
+      lock_acquire (&pool->lock);
+      page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+      lock_release (&pool->lock);
+      if (page_idx != BITMAP_ERROR)
+        break;
+
+      /* On failure, first try to borrow idle pages from the other
+         pool.  As a last resort, drain caches. */
+      if (borrow_pages (pool, page_cnt))
+        continue;
+      if (!shrink_caches (flags, page_cnt))
+        break;
+    }
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -88,6 +193,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
   if (pages != NULL)
     {
+      count_pages (pool, page_cnt, 0);
       if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
@@ -113,6 +219,88 @@ palloc_get_page (enum palloc_flags flags)
   return palloc_get_multiple (flags, 1);
 }
 
+/* Obtains a single free page to be mapped at virtual page VPAGE
+   and returns its kernel virtual address.  If page coloring is
+   enabled, prefers a page of the same color as VPAGE, but any
+   page will do if none of that color is free.  FLAGS are
+   interpreted as for palloc_get_page(). */
+void *
+palloc_get_colored_page (enum palloc_flags flags, const void *vpage)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t page_cnt, first_idx, page_idx;
+  void *page;
+
+  if (palloc_page_colors <= 1)
+    return palloc_get_page (flags);
+
+  /* Probe only the pages of VPAGE's color, which are spaced
+     palloc_page_colors apart. */
+  page_cnt = bitmap_size (pool->used_map);
+  first_idx = ((pg_no (vpage) % palloc_page_colors + palloc_page_colors
+                - (vtop (pool->base) >> PGBITS) % palloc_page_colors)
+               % palloc_page_colors);
+  lock_acquire (&pool->lock);
+  for (page_idx = first_idx; page_idx < page_cnt;
+       page_idx += palloc_page_colors)
+    if (!bitmap_test (pool->used_map, page_idx))
+      {
+        bitmap_mark (pool->used_map, page_idx);
+        break;
+      }
+  lock_release (&pool->lock);
+
+  if (page_idx >= page_cnt)
+    {
+      color_misses++;
+      return palloc_get_page (flags);
+    }
+  color_hits++;
+
+  page = pool->base + PGSIZE * page_idx;
+  count_pages (pool, 1, 0);
+  if (flags & PAL_ZERO)
+    memset (page, 0, PGSIZE);
+  return page;
+}
+
+/* Obtains PAGE_CNT contiguous free pages whose physical address
+   is a multiple of ALIGN pages, for example for a large page, and
+   returns the kernel virtual address of the first.  Returns a
+   null pointer if no such run is free, without borrowing or
+   shrinking: such runs are a luxury that the caller must be able
+   to do without.  FLAGS are interpreted as for
+   palloc_get_multiple(), except that PAL_ASSERT is not allowed. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt, size_t align)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t bit_cnt, page_idx;
+  void *pages;
+
+  ASSERT (!(flags & PAL_ASSERT));
+  ASSERT (align > 0);
+
+  bit_cnt = bitmap_size (pool->used_map);
+  page_idx = (align - (vtop (pool->base) >> PGBITS) % align) % align;
+  lock_acquire (&pool->lock);
+  for (; page_idx + page_cnt <= bit_cnt; page_idx += align)
+    if (bitmap_none (pool->used_map, page_idx, page_cnt))
+      {
+        bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+        break;
+      }
+  lock_release (&pool->lock);
+  if (page_idx + page_cnt > bit_cnt)
+    return NULL;
+
+  pages = pool->base + PGSIZE * page_idx;
+  count_pages (pool, page_cnt, 0);
+  if (flags & PAL_ZERO)
+    memset (pages, 0, PGSIZE * page_cnt);
+  return pages;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt)
@@ -139,6 +327,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  count_pages (pool, 0, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +337,119 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END,
-   naming it NAME for debugging purposes. */
+/* Registers shrinker S, whose statistics must be zero.  S will be
+   invoked whenever a pool runs out of pages. */
+void
+palloc_register_shrinker (struct shrinker *s)
+{
+  ASSERT (s != NULL && s->shrink != NULL);
+
+  lock_acquire (&shrink_lock);
+  list_push_back (&shrinkers, &s->elem);
+  lock_release (&shrink_lock);
+}
+
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool.  Pages that the
+   pool could borrow from the other pool are not counted. */
+size_t
+palloc_free_cnt (enum palloc_flags flags)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level = intr_disable ();
+  size_t free_cnt = pool->page_cnt - pool->used_cnt;
+  intr_set_level (old_level);
+  return free_cnt;
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  struct list_elem *e;
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *p = pools[i];
+      printf ("Palloc: %s: %zu pages, %zu in use, peak %zu in use, "
+              "low %zu free, %zu chunks borrowed, %zu chunks lent\n",
+              p->name, p->page_cnt, p->used_cnt, p->peak_used,
+              p->min_free, p->borrowed_chunks, p->lent_chunks);
+    }
+  if (palloc_page_colors > 1)
+    printf ("Palloc: %zu colors, %lld pages of matching color, "
+            "%lld of other colors\n",
+            palloc_page_colors, color_hits, color_misses);
+
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      printf ("Shrinker %s: %zu pages reclaimed in %zu calls\n",
+              s->name, s->reclaimed, s->calls);
+    }
+}
+
+/* Asks the registered shrinkers to free PAGE_CNT pages from the
+   pool selected by FLAGS.  Returns true if any pages were freed,
+   in which case the caller should retry its allocation, false
+   if no more pages can be reclaimed. */
+static bool
+shrink_caches (enum palloc_flags flags, size_t page_cnt)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+
+  /* A shrinker that allocates would recurse back here.  Report
+     failure rather than deadlock. */
+  if (lock_held_by_current_thread (&shrink_lock))
+    return false;
+
+  lock_acquire (&shrink_lock);
+  for (e = list_begin (&shrinkers);
+       e != list_end (&shrinkers) && freed < page_cnt; e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      size_t cnt = s->shrink (flags, page_cnt - freed);
+      s->calls++;
+      s->reclaimed += cnt;
+      freed += cnt;
+    }
+  lock_release (&shrink_lock);
+
+  return freed > 0;
+}
+
+/* Initializes pool P as owning the PAGE_CNT pages starting at
+   page FIRST_PAGE of the TOTAL_PAGES pages of free memory that
+   begin at BASE, naming it NAME for debugging purposes.  P's
+   used_map is placed at *BM_BUF, which is advanced past it. */
 static void
-init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
+init_pool (struct pool *p, void **bm_buf, void *base, size_t first_page,
+           size_t page_cnt, size_t total_pages, const char *name)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t bm_size = bitmap_buf_size (total_pages);
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
+  /* Initialize the pool.  Pages owned by the other pool are
+     permanently "in use" as far as this pool is concerned. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  p->used_map = bitmap_create_in_buf (total_pages, *bm_buf, bm_size);
+  *bm_buf = (uint8_t *) *bm_buf + bm_size;
+  bitmap_set_all (p->used_map, true);
+  bitmap_set_multiple (p->used_map, first_page, page_cnt, false);
+  p->base = base;
+  p->name = name;
+
+  p->page_cnt = page_cnt;
+  p->min_pages = page_cnt / 2;
+  p->max_pages = total_pages;
+  p->borrowed_chunks = p->lent_chunks = 0;
+  p->used_cnt = p->peak_used = 0;
+  p->min_free = page_cnt;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -178,5 +461,64 @@ page_from_pool (const struct pool *pool, void *page)
   size_t start_page = pg_no (pool->base);
   size_t end_page = start_page + bitmap_size (pool->used_map);
 
-  return page_no >= start_page && page_no < end_page;
+  return (page_no >= start_page && page_no < end_page
+          && bitmap_test (user_map, page_no - start_page)
+             == (pool == &user_pool));
+}
+
+/* Records that ALLOC_CNT pages were allocated from POOL and
+   FREE_CNT pages were freed, and updates its watermarks. */
+static void
+count_pages (struct pool *pool, size_t alloc_cnt, size_t free_cnt)
+{
+  enum intr_level old_level = intr_disable ();
+
+  pool->used_cnt += alloc_cnt;
+  pool->used_cnt -= free_cnt;
+  if (pool->used_cnt > pool->peak_used)
+    pool->peak_used = pool->used_cnt;
+  if (pool->page_cnt - pool->used_cnt < pool->min_free)
+    pool->min_free = pool->page_cnt - pool->used_cnt;
+
+  intr_set_level (old_level);
+}
+
+/* Moves a run of at least PAGE_CNT free pages, rounded up to a
+   whole number of chunks, from the other pool into POOL.
+   Returns true if successful, false if the lender has no such
+   run to spare or POOL may not grow that much. */
+static bool
+borrow_pages (struct pool *pool, size_t page_cnt)
+{
+  struct pool *lender = pool == &user_pool ? &kernel_pool : &user_pool;
+  size_t cnt = ROUND_UP (page_cnt, PAL_CHUNK_PAGES);
+  size_t page_idx = BITMAP_ERROR;
+
+  /* Always lock the kernel pool first, to avoid deadlock. */
+  lock_acquire (&kernel_pool.lock);
+  lock_acquire (&user_pool.lock);
+
+  if (pool->page_cnt + cnt <= pool->max_pages
+      && lender->page_cnt >= lender->min_pages + cnt)
+    page_idx = bitmap_scan_and_flip (lender->used_map, 0, cnt, false);
+  if (page_idx != BITMAP_ERROR)
+    {
+      enum intr_level old_level;
+
+      bitmap_set_multiple (user_map, page_idx, cnt, pool == &user_pool);
+      bitmap_set_multiple (pool->used_map, page_idx, cnt, false);
+
+      old_level = intr_disable ();
+      lender->page_cnt -= cnt;
+      pool->page_cnt += cnt;
+      intr_set_level (old_level);
+
+      lender->lent_chunks += cnt / PAL_CHUNK_PAGES;
+      pool->borrowed_chunks += cnt / PAL_CHUNK_PAGES;
+    }
+
+  lock_release (&user_pool.lock);
+  lock_release (&kernel_pool.lock);
+
+  return page_idx != BITMAP_ERROR;
 }
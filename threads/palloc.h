@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <list.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +12,34 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* A cache that can hand pages back to the page allocator when a
+   pool runs dry.  SHRINK should free up to PAGE_CNT pages from
+   the pool selected by FLAGS (only PAL_USER is meaningful) and
+   return the number of pages actually freed.  It runs in the
+   context of the failing allocation, so it must not sleep on a
+   lock that the allocating thread might hold and must not
+   allocate pages itself. */
+struct shrinker
+  {
+    const char *name;                   /* Name, for statistics. */
+    size_t (*shrink) (enum palloc_flags flags, size_t page_cnt);
+    size_t reclaimed;                   /* Pages reclaimed so far. */
+    size_t calls;                       /* Times invoked. */
+    struct list_elem elem;              /* Element in shrinker list. */
+  };
+
+/* Number of page colors, or 0 if page coloring is disabled. */
+extern size_t palloc_page_colors;
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_colored_page (enum palloc_flags, const void *vpage);
+void *palloc_get_aligned (enum palloc_flags, size_t page_cnt, size_t align);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_register_shrinker (struct shrinker *);
+size_t palloc_free_cnt (enum palloc_flags);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
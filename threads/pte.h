@@ -53,6 +53,9 @@ static inline uintptr_t pd_no (const void *va) {
 
    In a PDE, the physical address points to a page table.
    In a PTE, the physical address points to a data or code page.
+   A PDE with PTE_PS set instead maps a 4 MB "large page" directly
+   (this requires CR4.PSE); only bits 22:31 of its physical
+   address are used, and it takes the dirty bit like a PTE.
    The important flags are listed below.
    When a PDE or PTE is not "present", the other flags are
    ignored.
@@ -66,6 +69,10 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
+
+/* Address bits of a large page PDE. */
+#define LPDE_ADDR PDMASK
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -77,9 +84,38 @@ static inline uint32_t pde_create (uint32_t *pt) {
    PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
   ASSERT (pde & PTE_P);
+  ASSERT (!(pde & PTE_PS));
   return ptov (pde & PTE_ADDR);
 }
 
+/* Returns a PDE that maps the 4 MB large page at PAGE.
+   The page is readable.
+   If WRITABLE is true then it will be writable as well.
+   The page will be usable only by ring 0 code (the kernel). */
+static inline uint32_t pde_create_large_kernel (void *page, bool writable) {
+  ASSERT (((uintptr_t) page & ~LPDE_ADDR) == 0);
+  return vtop (page) | PTE_PS | PTE_P | (writable ? PTE_W : 0);
+}
+
+/* Returns a PDE that maps the 4 MB large page at PAGE.
+   The page is readable.
+   If WRITABLE is true then it will be writable as well.
+   The page will be usable by both user and kernel code. */
+static inline uint32_t pde_create_large_user (void *page, bool writable) {
+  return pde_create_large_kernel (page, writable) | PTE_U;
+}
+
+/* Returns true if PDE is present and maps a large page. */
+static inline bool pde_is_large (uint32_t pde) {
+  return (pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS);
+}
+
+/* Returns a pointer to the large page that PDE maps. */
+static inline void *pde_get_large_page (uint32_t pde) {
+  ASSERT (pde_is_large (pde));
+  return ptov (pde & LPDE_ADDR);
+}
+
 /* Returns a PTE that points to PAGE.
    The PTE's page is readable.
    If WRITABLE is true then it will be writable as well.
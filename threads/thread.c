@@ -321,14 +321,18 @@ void
 thread_exit (void)
 {
   ASSERT (!intr_context ());
+#ifdef USERPROG
+  /* Release the address space first: its mapped files must be
+     written back, and its pages may still be read from the
+     executable, before the parent sees the exit.  The page
+     directory may be left to the reaper. */
+  process_exit ();
+#endif
    if( thread_current()->file != NULL ) file_close(thread_current()->file);
    free_child();
    free_fdt();
    if (thread_current()->dir) dir_close(thread_current()->dir);
   sema_up(&thread_current ()->c->sema);
-#ifdef USERPROG
-  process_exit ();
-#endif
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy usF
@@ -512,6 +516,10 @@ init_thread (struct thread *t, const char *name, int priority)
   t->dir = NULL;
   list_init(&t->children);
   list_init(&t->fdt);
+#ifdef VM
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+#endif
   if(t != initial_thread){
     t->c=(struct child_sema *)malloc(sizeof(struct child_sema));
 //    t->c->waited = false;
@@ -590,11 +598,17 @@ thread_schedule_tail (struct thread *prev)
      thread.  This must happen late so that thread_exit() doesn't
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
-     palloc().) */
+     palloc().)  A process that left its page directory behind
+     goes to the reaper instead, which frees it afterward. */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+#ifdef USERPROG
+      if (prev->pagedir != NULL)
+        process_reap (prev);
+      else
+#endif
+        palloc_free_page (prev);
     }
 }
 
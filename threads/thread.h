@@ -7,6 +7,9 @@
 #include <stdbool.h>
 #include "threads/vaddr.h"
 #include "threads/synch.h"
+#ifdef VM
+#include <hash.h>
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -22,6 +25,9 @@ enum thread_status
 typedef int tid_t;
 #define TID_ERROR ((tid_t) -1)          /* Error value for tid_t. */
 
+/* Most shared libraries a user process may use. */
+#define LIB_MAX 4
+
 /* Thread priorities. */
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
@@ -118,7 +124,7 @@ struct thread
 
 
     struct child_sema *c;
-    /* Shared between thread.c and synch.c. */
+    /* Shared between thread.c, synch.c, and process.c. */
     struct list_elem elem;              /* List element. */
     
     struct thread* parent;              /* the threads parent */
@@ -127,6 +133,28 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    uint8_t *brk_start;                 /* Start of heap. */
+    uint8_t *brk;                       /* End of heap. */
+    struct file *libs[LIB_MAX];         /* Shared libraries in use. */
+    size_t lib_cnt;                     /* Number of shared libraries. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    void *user_esp;                     /* User ESP at system call. */
+    long long fault_cnt;                /* Page faults taken. */
+    long long fault_around_cnt;         /* Pages mapped around faults. */
+    long long swap_in_cnt;              /* Pages read in from swap. */
+    long long swap_out_cnt;             /* Pages written out to swap. */
+    long long evict_cnt;                /* Pages evicted from frames. */
+    size_t rss_cnt;                     /* Pages resident in frames. */
+    size_t swap_cnt;                    /* Pages in swap. */
+    bool out_of_frames;                 /* Frame allocation failed? */
+    bool oom_killed;                    /* Killed to free memory? */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
 #endif
 
     /* Owned by thread.c. */
@@ -0,0 +1,199 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous kernel page allocator.
+
+   palloc_get_multiple() can only satisfy a request for N pages
+   if N physically contiguous pages happen to be free in the
+   kernel pool, which becomes unlikely as the pool fragments.
+   The allocator here instead obtains each page separately from
+   the kernel pool and maps the pages side by side into a window
+   of kernel virtual address space that is reserved for the
+   purpose, well above the 1:1 mapping of physical memory.
+
+   The page tables that cover the window are allocated once, at
+   boot, and installed in init_page_dir.  Every page directory
+   created later by pagedir_create() copies those entries, so
+   mappings added to or removed from the window afterward are
+   seen by every process without further work.
+
+   Each allocation is followed by an unmapped guard page.
+   Besides catching overruns, the guard lets
+   vmalloc_free_pages() find the end of an allocation by walking
+   page table entries until it reaches one that is not present,
+   so the size of an allocation never has to be recorded.
+
+   Memory in the window is not part of the 1:1 mapping, so
+   vtop() must not be applied to it.  In particular, it must not
+   be used for page tables, page directories, or anything else
+   whose physical address is handed to the hardware. */
+
+/* Bitmap of window pages in use, including guard pages. */
+static struct bitmap *used_map;
+static struct lock vmalloc_lock;
+
+static size_t unmap_pages (uint8_t *pages);
+static uint32_t *window_pte (const void *vaddr);
+static void flush_tlb (void);
+
+/* Creates the page tables that cover the vmalloc window and
+   installs them in the initial page directory.  Must be called
+   after paging_init() and before the first call to
+   pagedir_create(). */
+void
+vmalloc_init (void)
+{
+  uint8_t *va;
+
+  ASSERT (pg_ofs (VMALLOC_START) == 0);
+  ASSERT ((uintptr_t) VMALLOC_START % PTSPAN == 0);
+  ASSERT ((uint8_t *) ptov (init_ram_pages * PGSIZE)
+          <= (uint8_t *) VMALLOC_START);
+
+  for (va = VMALLOC_START; va < (uint8_t *) VMALLOC_START
+                                 + VMALLOC_PAGES * PGSIZE; va += PTSPAN)
+    {
+      uint32_t *pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      init_page_dir[pd_no (va)] = pde_create (pt);
+    }
+
+  lock_init (&vmalloc_lock);
+  used_map = bitmap_create (VMALLOC_PAGES);
+  if (used_map == NULL)
+    PANIC ("vmalloc: out of memory for window bitmap");
+
+  printf ("%d pages of kernel address space reserved for vmalloc.\n",
+          VMALLOC_PAGES);
+}
+
+/* Obtains PAGE_CNT pages from the kernel pool, which need not be
+   physically contiguous, and returns the kernel virtual address
+   of a window in which they appear contiguous.  PAL_USER may not
+   be set in FLAGS.  If PAL_ZERO is set, the pages are filled
+   with zeros.  If the window or the kernel pool is exhausted,
+   returns a null pointer, unless PAL_ASSERT is set in FLAGS, in
+   which case the kernel panics. */
+void *
+vmalloc_get_pages (enum palloc_flags flags, size_t page_cnt)
+{
+  uint8_t *pages;
+  size_t page_idx;
+  size_t i;
+
+  ASSERT ((flags & PAL_USER) == 0);
+
+  if (page_cnt == 0)
+    return NULL;
+
+  /* Reserve PAGE_CNT pages of address space plus a guard page. */
+  lock_acquire (&vmalloc_lock);
+  page_idx = bitmap_scan_and_flip (used_map, 0, page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+  if (page_idx == BITMAP_ERROR)
+    goto fail;
+  pages = (uint8_t *) VMALLOC_START + page_idx * PGSIZE;
+
+  /* Back each page of the reservation with a kernel page.
+     Newly present PTEs need no TLB flush. */
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *kpage = palloc_get_page (flags & PAL_ZERO);
+      if (kpage == NULL)
+        {
+          unmap_pages (pages);
+          lock_acquire (&vmalloc_lock);
+          bitmap_set_multiple (used_map, page_idx, page_cnt + 1, false);
+          lock_release (&vmalloc_lock);
+          goto fail;
+        }
+      *window_pte (pages + i * PGSIZE) = pte_create_kernel (kpage, true);
+    }
+  return pages;
+
+ fail:
+  if (flags & PAL_ASSERT)
+    PANIC ("vmalloc: out of pages");
+  return NULL;
+}
+
+/* Frees PAGES, which must have been returned by
+   vmalloc_get_pages(). */
+void
+vmalloc_free_pages (void *pages)
+{
+  size_t page_idx, page_cnt;
+
+  if (pages == NULL)
+    return;
+  ASSERT (is_vmalloc_vaddr (pages));
+  ASSERT (pg_ofs (pages) == 0);
+
+  page_cnt = unmap_pages (pages);
+  ASSERT (page_cnt > 0);
+
+  page_idx = pg_no (pages) - pg_no (VMALLOC_START);
+  lock_acquire (&vmalloc_lock);
+  ASSERT (bitmap_all (used_map, page_idx, page_cnt + 1));
+  bitmap_set_multiple (used_map, page_idx, page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+}
+
+/* Returns true if VADDR lies within the vmalloc window. */
+bool
+is_vmalloc_vaddr (const void *vaddr)
+{
+  return ((const uint8_t *) vaddr >= (const uint8_t *) VMALLOC_START
+          && ((const uint8_t *) vaddr
+              < (const uint8_t *) VMALLOC_START + VMALLOC_PAGES * PGSIZE));
+}
+
+/* Unmaps the pages starting at PAGES, up to the first page that
+   is not present, and returns them to the kernel pool.  Returns
+   the number of pages unmapped. */
+static size_t
+unmap_pages (uint8_t *pages)
+{
+  uint32_t *pte;
+  size_t page_cnt = 0;
+
+  for (; (pte = window_pte (pages)) != NULL && (*pte & PTE_P) != 0;
+       pages += PGSIZE)
+    {
+      void *kpage = pte_get_page (*pte);
+      *pte = 0;
+      palloc_free_page (kpage);
+      page_cnt++;
+    }
+  if (page_cnt > 0)
+    flush_tlb ();
+  return page_cnt;
+}
+
+/* Returns the page table entry for VADDR in the vmalloc window,
+   or a null pointer if VADDR is outside the window. */
+static uint32_t *
+window_pte (const void *vaddr)
+{
+  if (!is_vmalloc_vaddr (vaddr))
+    return NULL;
+  return &pde_get_pt (init_page_dir[pd_no (vaddr)])[pt_no (vaddr)];
+}
+
+/* Flushes the TLB, so that PTEs cleared in the window take
+   effect.  Reloading CR3 suffices because kernel mappings are
+   not marked global.  See [IA32-v3a] 3.12 "Translation
+   Lookaside Buffers (TLBs)". */
+static void
+flush_tlb (void)
+{
+  uintptr_t pd;
+  asm volatile ("movl %%cr3, %0; movl %0, %%cr3" : "=r" (pd) : : "memory");
+}
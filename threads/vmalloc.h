@@ -0,0 +1,17 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/palloc.h"
+
+/* Kernel virtual address window used by vmalloc. */
+#define VMALLOC_START ((void *) 0xe0000000)    /* Base of window. */
+#define VMALLOC_PAGES 4096                      /* Size in pages (16 MB). */
+
+void vmalloc_init (void);
+void *vmalloc_get_pages (enum palloc_flags, size_t page_cnt);
+void vmalloc_free_pages (void *);
+bool is_vmalloc_vaddr (const void *);
+
+#endif /* threads/vmalloc.h */
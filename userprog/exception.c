@@ -4,6 +4,11 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/oom.h"
+#include "vm/page.h"
+#endif
 
 
 
@@ -151,7 +156,31 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  thread_current ()->fault_cnt++;
+  thread_current ()->out_of_frames = false;
+
+  /* A page that is part of the process's address space but is not
+     in memory is brought in now, an access just below the stack
+     grows the stack, and a write to a page shared copy-on-write
+     gets a copy of its own.  This holds whether the process itself
+     or the kernel, on its behalf, touched it; in the latter case
+     F->esp is the kernel's stack pointer, so use the one saved at
+     system call entry. */
+  if (is_user_vaddr (fault_addr)
+      && (not_present
+          ? (page_load (fault_addr, write)
+             || page_grow_stack (fault_addr,
+                                 user ? f->esp : thread_current ()->user_esp))
+          : write && page_unshare (fault_addr)))
+    return;
 
+  /* If the fault failed for want of a frame, kill the process
+     that holds the most memory, and if that was some other
+     process, retry. */
+  if (thread_current ()->out_of_frames && oom_kill ())
+    return;
+#endif
 
   if (!user){
     f->eip = (void (*)(void))f->eax;
@@ -1,13 +1,25 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/thread.h"
+
+/* Large page statistics. */
+static long long large_cnt, split_cnt;
+
+/* Page table statistics. */
+static long long pt_alloc_cnt, pt_free_cnt;
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static bool split_large_page (uint32_t *pd, const void *vaddr);
+static uint32_t *unlink_empty_pt (uint32_t *pde);
+static uint32_t *lookup_large_page (uint32_t *pd, const void *vaddr);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -34,7 +46,9 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P)
+    if (pde_is_large (*pde))
+      palloc_free_multiple (pde_get_large_page (*pde), PTSPAN / PGSIZE);
+    else if (*pde & PTE_P)
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
@@ -50,34 +64,38 @@ pagedir_destroy (uint32_t *pd)
 /* Returns the address of the page table entry for virtual
    address VADDR in page directory PD.
    If PD does not have a page table for VADDR, behavior depends
-   on CREATE.  If CREATE is true, then a new page table is
-   created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   on NEW_PT.  If NEW_PT points to a zeroed page, then that page
+   becomes VADDR's page table, *NEW_PT is set to a null pointer,
+   and a pointer into it is returned.  Otherwise, a null pointer
+   is returned.
+   VADDR must not lie in a large page: split_large_page() first.
+
+   Interrupts must be off, and stay off while the caller uses the
+   PTE, because another thread may free the page table through
+   pagedir_clear_page().  For the same reason, this function
+   allocates no memory, since that could sleep. */
 static uint32_t *
-lookup_page (uint32_t *pd, const void *vaddr, bool create)
+lookup_page (uint32_t *pd, const void *vaddr, uint32_t **new_pt)
 {
   uint32_t *pt, *pde;
 
   ASSERT (pd != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
 
   /* Shouldn't create new kernel virtual mappings. */
-  ASSERT (!create || is_user_vaddr (vaddr));
+  ASSERT (new_pt == NULL || is_user_vaddr (vaddr));
 
   /* Check for a page table for VADDR.
-     If one is missing, create one if requested. */
+     If one is missing, install NEW_PT if there is one. */
   pde = pd + pd_no (vaddr);
+  ASSERT (!pde_is_large (*pde));
   if (*pde == 0)
     {
-      if (create)
-        {
-          pt = palloc_get_page (PAL_ZERO);
-          if (pt == NULL)
-            return NULL;
-
-          *pde = pde_create (pt);
-        }
-      else
+      if (new_pt == NULL || *new_pt == NULL)
         return NULL;
+      *pde = pde_create (*new_pt);
+      *new_pt = NULL;
+      pt_alloc_cnt++;
     }
 
   /* Return the page table entry. */
@@ -98,7 +116,9 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
 bool
 pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
 {
+  enum intr_level old_level;
   uint32_t *pte;
+  bool success;
 
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (pg_ofs (kpage) == 0);
@@ -106,16 +126,64 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
   ASSERT (vtop (kpage) >> PTSHIFT < init_ram_pages);
   ASSERT (pd != init_page_dir);
 
-  pte = lookup_page (pd, upage, true);
-
-  if (pte != NULL)
+  /* A page table, if one is needed, must be allocated before
+     interrupts are turned off for lookup_page().  By then,
+     another thread may have freed the page table that UPAGE goes
+     in, or created the one that it lacked, so check again. */
+  do
     {
-      ASSERT ((*pte & PTE_P) == 0);
-      *pte = pte_create_user (kpage, writable);
-      return true;
+      uint32_t *pt = NULL;
+
+      if (!split_large_page (pd, upage))
+        return false;
+      if (pd[pd_no (upage)] == 0)
+        {
+          pt = palloc_get_page (PAL_ZERO);
+          if (pt == NULL)
+            return false;
+        }
+
+      old_level = intr_disable ();
+      pte = lookup_page (pd, upage, &pt);
+      success = pte != NULL;
+      if (success)
+        {
+          ASSERT ((*pte & PTE_P) == 0);
+          *pte = pte_create_user (kpage, writable);
+        }
+      intr_set_level (old_level);
+
+      if (pt != NULL)
+        palloc_free_page (pt);
     }
-  else
+  while (!success);
+  return true;
+}
+
+/* Adds a mapping in page directory PD from the 4 MB of user
+   virtual memory starting at UPAGE to the physical memory
+   starting at kernel virtual address KPAGE, as a single large
+   page.  Both must be aligned on 4 MB and KPAGE should probably
+   be obtained from the user pool with palloc_get_aligned().  If
+   WRITABLE is true, the memory is read/write; otherwise it is
+   read-only.  Returns true if successful, false if any of the
+   4 MB is already mapped. */
+bool
+pagedir_set_large_page (uint32_t *pd, void *upage, void *kpage,
+                        bool writable)
+{
+  uint32_t *pde;
+
+  ASSERT ((uintptr_t) upage % PTSPAN == 0);
+  ASSERT (is_user_vaddr ((uint8_t *) upage + PTSPAN - 1));
+  ASSERT (pd != init_page_dir);
+
+  pde = pd + pd_no (upage);
+  if (*pde != 0)
     return false;
+  *pde = pde_create_large_user (kpage, writable);
+  large_cnt++;
+  return true;
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -125,35 +193,96 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
 void *
 pagedir_get_page (uint32_t *pd, const void *uaddr)
 {
+  enum intr_level old_level;
   uint32_t *pte;
+  void *kaddr = NULL;
 
   ASSERT (is_user_vaddr (uaddr));
 
-  pte = lookup_page (pd, uaddr, false);
-  if (pte != NULL && (*pte & PTE_P) != 0)
-    return pte_get_page (*pte) + pg_ofs (uaddr);
+  old_level = intr_disable ();
+  pte = lookup_large_page (pd, uaddr);
+  if (pte != NULL)
+    kaddr = ((uint8_t *) pde_get_large_page (*pte)
+             + ((uintptr_t) uaddr & ~LPDE_ADDR));
   else
-    return NULL;
+    {
+      pte = lookup_page (pd, uaddr, NULL);
+      if (pte != NULL && (*pte & PTE_P) != 0)
+        kaddr = pte_get_page (*pte) + pg_ofs (uaddr);
+    }
+  intr_set_level (old_level);
+  return kaddr;
 }
 
 /* Marks user virtual page UPAGE "not present" in page
    directory PD.  Later accesses to the page will fault.  Other
-   bits in the page table entry are preserved.
+   bits in the page table entry are preserved, unless UPAGE was
+   the last page mapped by its page table, in which case the page
+   table is freed.  Returns true if UPAGE was dirty, so that a
+   caller that must know can read the dirty bit only after the
+   page can no longer be written.
    UPAGE need not be mapped. */
-void
+bool
 pagedir_clear_page (uint32_t *pd, void *upage)
 {
-  uint32_t *pte;
+  enum intr_level old_level;
+  uint32_t *pte, *empty_pt = NULL;
+  bool dirty = false;
 
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (is_user_vaddr (upage));
 
-  pte = lookup_page (pd, upage, false);
+  if (!split_large_page (pd, upage))
+    return false;
+
+  old_level = intr_disable ();
+  pte = lookup_page (pd, upage, NULL);
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
+      dirty = (*pte & PTE_D) != 0;
+      empty_pt = unlink_empty_pt (pd + pd_no (upage));
       invalidate_pagedir (pd);
     }
+  intr_set_level (old_level);
+
+  if (empty_pt != NULL)
+    palloc_free_page (empty_pt);
+  return dirty;
+}
+
+/* If the page table that PDE points to no longer maps any page,
+   removes it from PDE and returns it, for the caller to free once
+   interrupts are back on, so that a process that touches sparse
+   regions of its address space does not keep a page table for
+   every 4 MB region it ever used.  Otherwise, returns a null
+   pointer.  The caller must invalidate the TLB. */
+static uint32_t *
+unlink_empty_pt (uint32_t *pde)
+{
+  uint32_t *pt = pde_get_pt (*pde);
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *pt; i++)
+    if (pt[i] & PTE_P)
+      return NULL;
+  *pde = 0;
+  pt_free_cnt++;
+  return pt;
+}
+
+/* Returns the number of page tables in PD, not counting the
+   kernel's, which every page directory shares. */
+size_t
+pagedir_pt_cnt (uint32_t *pd)
+{
+  uint32_t *pde;
+  size_t cnt = 0;
+
+  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
+    if ((*pde & PTE_P) && !pde_is_large (*pde))
+      cnt++;
+  return cnt;
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
@@ -163,8 +292,15 @@ pagedir_clear_page (uint32_t *pd, void *upage)
 bool
 pagedir_is_dirty (uint32_t *pd, const void *vpage)
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  return pte != NULL && (*pte & PTE_D) != 0;
+  enum intr_level old_level = intr_disable ();
+  uint32_t *pte = lookup_large_page (pd, vpage);
+  bool dirty;
+
+  if (pte == NULL)
+    pte = lookup_page (pd, vpage, NULL);
+  dirty = pte != NULL && (*pte & PTE_D) != 0;
+  intr_set_level (old_level);
+  return dirty;
 }
 
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
@@ -172,7 +308,13 @@ pagedir_is_dirty (uint32_t *pd, const void *vpage)
 void
 pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  enum intr_level old_level;
+  uint32_t *pte;
+
+  if (!split_large_page (pd, vpage))
+    return;
+  old_level = intr_disable ();
+  pte = lookup_page (pd, vpage, NULL);
   if (pte != NULL)
     {
       if (dirty)
@@ -183,6 +325,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
           invalidate_pagedir (pd);
         }
     }
+  intr_set_level (old_level);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD has been
@@ -192,8 +335,15 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
 bool
 pagedir_is_accessed (uint32_t *pd, const void *vpage)
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  return pte != NULL && (*pte & PTE_A) != 0;
+  enum intr_level old_level = intr_disable ();
+  uint32_t *pte = lookup_large_page (pd, vpage);
+  bool accessed;
+
+  if (pte == NULL)
+    pte = lookup_page (pd, vpage, NULL);
+  accessed = pte != NULL && (*pte & PTE_A) != 0;
+  intr_set_level (old_level);
+  return accessed;
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
@@ -201,7 +351,13 @@ pagedir_is_accessed (uint32_t *pd, const void *vpage)
 void
 pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  enum intr_level old_level;
+  uint32_t *pte;
+
+  if (!split_large_page (pd, vpage))
+    return;
+  old_level = intr_disable ();
+  pte = lookup_page (pd, vpage, NULL);
   if (pte != NULL)
     {
       if (accessed)
@@ -212,6 +368,65 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
           invalidate_pagedir (pd);
         }
     }
+  intr_set_level (old_level);
+}
+
+/* Makes the PTE for virtual page VPAGE in PD writable if
+   WRITABLE is true, read-only otherwise.  Does nothing if VPAGE
+   has no PTE. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
+{
+  enum intr_level old_level;
+  uint32_t *pte;
+
+  if (!split_large_page (pd, vpage))
+    return;
+  old_level = intr_disable ();
+  pte = lookup_page (pd, vpage, NULL);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+  intr_set_level (old_level);
+}
+
+/* Points the mapping for virtual page VPAGE in PD at kernel
+   virtual address KPAGE instead of the page it maps now, making
+   it read-only and keeping its accessed and dirty bits.  Does
+   nothing if VPAGE is not mapped. */
+void
+pagedir_remap_page (uint32_t *pd, const void *vpage, void *kpage)
+{
+  enum intr_level old_level;
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (kpage) == 0);
+
+  if (!split_large_page (pd, vpage))
+    return;
+  old_level = intr_disable ();
+  pte = lookup_page (pd, vpage, NULL);
+  if (pte != NULL && (*pte & PTE_P) != 0)
+    {
+      *pte = (*pte & PTE_FLAGS & ~(uint32_t) PTE_W) | vtop (kpage);
+      invalidate_pagedir (pd);
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints large page statistics. */
+void
+pagedir_print_stats (void)
+{
+  printf ("Pagedir: %lld large pages mapped, %lld split\n",
+          large_cnt, split_cnt);
+  printf ("Pagedir: %lld page tables allocated, %lld freed when emptied\n",
+          pt_alloc_cnt, pt_free_cnt);
 }
 
 /* Loads page directory PD into the CPU's page directory base
@@ -243,6 +458,58 @@ active_pd (void)
   return ptov (pd);
 }
 
+/* Returns the PDE in PD for the large page that contains VADDR,
+   or a null pointer if VADDR does not lie in a large page. */
+static uint32_t *
+lookup_large_page (uint32_t *pd, const void *vaddr)
+{
+  uint32_t *pde = pd + pd_no (vaddr);
+  return pde_is_large (*pde) ? pde : NULL;
+}
+
+/* If VADDR lies in a large page in PD, replaces the large page
+   with a page table that maps the same memory with 4 kB pages
+   that have the same flags, so that their protections can
+   diverge.  Called before examining or changing the PTE of just
+   one of those pages.  Returns true if successful, false if
+   memory allocation fails. */
+static bool
+split_large_page (uint32_t *pd, const void *vaddr)
+{
+  uint32_t *pde = pd + pd_no (vaddr);
+  enum intr_level old_level;
+  uint32_t *pt;
+  size_t i;
+
+  if (!pde_is_large (*pde))
+    return true;
+
+  /* Allocate with interrupts on, then check that no other thread
+     split the page meanwhile. */
+  pt = palloc_get_page (0);
+  if (pt == NULL)
+    return false;
+  old_level = intr_disable ();
+  if (pde_is_large (*pde))
+    {
+      uint8_t *page = pde_get_large_page (*pde);
+      uint32_t flags = *pde & (PTE_U | PTE_W | PTE_A | PTE_D | PTE_P);
+
+      for (i = 0; i < PGSIZE / sizeof *pt; i++)
+        pt[i] = vtop (page + i * PGSIZE) | flags;
+      *pde = pde_create (pt);
+      invalidate_pagedir (pd);
+      split_cnt++;
+      pt_alloc_cnt++;
+      pt = NULL;
+    }
+  intr_set_level (old_level);
+
+  if (pt != NULL)
+    palloc_free_page (pt);
+  return true;
+}
+
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
    table.  When this happens, we have to "invalidate" the TLB by
@@ -11,19 +11,53 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "lib/kernel/list.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 #include <stdbool.h>
 
 #define LOGGING_LEVEL 6
 
 #include "lib/log.h"
 
+#ifndef VM
+/* -large-pages: Load whole, aligned 4 MB stretches of segments
+   into large pages? */
+bool process_large_pages;
+#endif
+
+/* Address at which the first shared library is loaded.  The
+   others follow it, and the heap may not grow past it. */
+#define LIB_BASE 0x40000000
+
+/* An exiting process leaves the destruction of its page
+   directory to the reaper thread, so that its parent, waiting in
+   process_wait(), does not wait for it.  Without VM, that frees
+   every page the process held.  With VM, the process releases
+   its frames and swap slots itself before it exits, so that the
+   page-out daemon never writes a dead process's pages to swap,
+   which leaves the reaper only the page directory and any page
+   tables.  The process's struct thread lives on until the reaper
+   is done.  At most REAP_MAX exited processes wait to be reaped;
+   beyond that, a process destroys its own page directory, so
+   that exits cannot outrun the reaper. */
+#define REAP_MAX 8
+static struct list reap_list;   /* Exited processes to reap. */
+static size_t reap_cnt;         /* Processes reaped or to be reaped. */
+static struct semaphore reap_sema; /* Upped for each process to reap. */
+static thread_func reaper NO_RETURN;
+
 static struct list args_list;
 int listlength;
 
@@ -164,6 +198,139 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Passed from process_fork() to start_fork(). */
+struct fork_info
+  {
+    struct intr_frame if_;      /* Parent's user context. */
+    struct thread *parent;      /* Forking process. */
+    struct semaphore done;      /* Upped once the child is set up. */
+    bool success;               /* Was the child set up? */
+  };
+
+static thread_func start_fork NO_RETURN;
+static bool copy_fdt (struct thread *parent);
+
+/* Starts a new process that is a copy of the current one and
+   resumes in user mode from IF_, the current process's system
+   call frame, with a return value of 0.  The two processes share
+   their memory copy-on-write, so forking costs copying page
+   tables rather than frames.  The child gets its own copies of
+   the open files but does not inherit memory-mapped files.
+   Returns the new process's thread id, or TID_ERROR if it cannot
+   be created. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct fork_info info;
+  tid_t tid;
+
+  info.if_ = *if_;
+  info.parent = thread_current ();
+  sema_init (&info.done, 0);
+  info.success = false;
+
+  tid = thread_create (thread_name (), PRI_DEFAULT, start_fork, &info);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&info.done);
+  return info.success ? tid : TID_ERROR;
+}
+
+/* A thread function that copies the forking process's address
+   space and open files and starts the copy running. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *t = thread_current ();
+  struct thread *parent = info->parent;
+  struct intr_frame if_ = info->if_;
+  size_t i;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto fail;
+  if (!page_table_init ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto fail;
+    }
+  process_activate ();
+
+  t->file = file_reopen (parent->file);
+  if (t->file == NULL)
+    goto fail;
+  t->brk_start = parent->brk_start;
+  t->brk = parent->brk;
+  file_deny_write (t->file);
+  for (i = 0; i < parent->lib_cnt; i++)
+    {
+      t->libs[i] = file_reopen (parent->libs[i]);
+      if (t->libs[i] == NULL)
+        goto fail;
+      t->lib_cnt++;
+      file_deny_write (t->libs[i]);
+    }
+
+  if (!page_table_copy (parent) || !copy_fdt (parent))
+    goto fail;
+  if (!t->dir)
+    t->dir = dir_open_root ();
+
+  /* INFO lives on the parent's stack, so it is gone once the
+     parent wakes up. */
+  info->success = true;
+  sema_up (&info->done);
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+
+ fail:
+  t->c->status = -1;
+  sema_up (&info->done);
+  thread_exit ();
+}
+
+/* Gives the current process its own copies of PARENT's open
+   files, under the same descriptors and at the same positions.
+   Returns false if memory allocation fails. */
+static bool
+copy_fdt (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->fdt); e != list_end (&parent->fdt);
+       e = list_next (e))
+    {
+      struct fdesc *pfd = list_entry (e, struct fdesc, elem);
+      struct fdesc *cfd = malloc (sizeof *cfd);
+
+      if (cfd == NULL)
+        return false;
+      if (inode_is_dir (file_get_inode (pfd->f)))
+        cfd->f = (struct file *) dir_reopen ((struct dir *) pfd->f);
+      else
+        {
+          cfd->f = file_reopen (pfd->f);
+          if (cfd->f != NULL)
+            file_seek (cfd->f, file_tell (pfd->f));
+        }
+      if (cfd->f == NULL)
+        {
+          free (cfd);
+          return false;
+        }
+      cfd->fd = pfd->fd;
+      list_push_back (&t->fdt, &cfd->elem);
+    }
+  return true;
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -200,13 +367,31 @@ void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool defer;
   uint32_t *pd;
 
   /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
+     to the kernel-only page directory, or leave that to the
+     reaper. */
   pd = cur->pagedir;
   if (pd != NULL)
     {
+      /* Memory-mapped files are written back now, so that the
+         parent sees their contents once it sees the exit.  The
+         supplemental page table goes next, while the page
+         directory that maps its frames is still in place. */
+#ifdef VM
+      mmap_unmap_all ();
+      page_table_destroy ();
+#endif
+
+      old_level = intr_disable ();
+      defer = reap_cnt < REAP_MAX;
+      if (defer)
+        reap_cnt++;
+      intr_set_level (old_level);
+
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -214,9 +399,66 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
-      cur->pagedir = NULL;
-      pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      if (!defer)
+        {
+          cur->pagedir = NULL;
+          pagedir_activate (NULL);
+          pagedir_destroy (pd);
+        }
+    }
+
+  /* Close the shared libraries, now that no page is read from
+     them any more. */
+  while (cur->lib_cnt > 0)
+    file_close (cur->libs[--cur->lib_cnt]);
+}
+
+/* Starts the reaper thread. */
+void
+process_start_reaper (void)
+{
+  list_init (&reap_list);
+  sema_init (&reap_sema, 0);
+  if (thread_create ("reaper", PRI_MIN, reaper, NULL) == TID_ERROR)
+    PANIC ("process: cannot start reaper thread");
+}
+
+/* Hands T, a process that has exited and been switched away from
+   for the last time, to the reaper, which destroys its page
+   directory and then frees T.  Called by the scheduler with
+   interrupts off. */
+void
+process_reap (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_DYING && t->pagedir != NULL);
+
+  list_push_back (&reap_list, &t->elem);
+  sema_up (&reap_sema);
+}
+
+/* The reaper thread.  Destroys the page directories of exited
+   processes, in the order they exited, using the kernel-only
+   page directory, which is active in every kernel thread. */
+static void
+reaper (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct thread *t;
+
+      sema_down (&reap_sema);
+      old_level = intr_disable ();
+      t = list_entry (list_pop_front (&reap_list), struct thread, elem);
+      intr_set_level (old_level);
+
+      pagedir_destroy (t->pagedir);
+      palloc_free_page (t);
+
+      old_level = intr_disable ();
+      reap_cnt--;
+      intr_set_level (old_level);
     }
 }
 
@@ -235,12 +477,101 @@ process_activate (void)
      interrupts. */
   tss_update ();
 }
+
+#ifndef VM
+static bool install_page (void *upage, void *kpage, bool writable);
+#endif
+static bool add_heap_page (void *upage);
+static void remove_heap_page (void *upage);
+
+/* Moves the end of the current process's heap, which starts
+   just above its highest loaded segment, by INCREMENT bytes, and
+   returns the old end.  Returns (void *) -1 without changing
+   anything if the heap would shrink below its start, run into
+   the shared libraries, the stack's reserved region, or another
+   mapping, or if memory is not available.
+
+   Under VM, new heap pages are only added to the supplemental
+   page table, so a page costs nothing until it is touched, and
+   a page that is only read maps the zero frame.  Otherwise they
+   are allocated and zeroed right away. */
+void *
+process_sbrk (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  uint8_t *old_brk = t->brk;
+  uint8_t *new_brk = (uint8_t *) ((uintptr_t) old_brk + increment);
+  uint8_t *old_end = (uint8_t *) ROUND_UP ((uintptr_t) old_brk, PGSIZE);
+  uint8_t *new_end = (uint8_t *) ROUND_UP ((uintptr_t) new_brk, PGSIZE);
+  uint8_t *upage;
+#ifdef VM
+  uint8_t *limit = (uint8_t *) PHYS_BASE - page_stack_limit * PGSIZE;
+#else
+  uint8_t *limit = (uint8_t *) PHYS_BASE - PGSIZE;
+#endif
+
+  if (t->lib_cnt > 0 && limit > (uint8_t *) LIB_BASE)
+    limit = (uint8_t *) LIB_BASE;
+  if (increment > 0
+      ? new_brk < old_brk || new_brk > limit
+      : new_brk > old_brk || new_brk < t->brk_start)
+    return (void *) -1;
+
+  for (upage = old_end; upage < new_end; upage += PGSIZE)
+    if (!add_heap_page (upage))
+      {
+        while (upage > old_end)
+          remove_heap_page (upage -= PGSIZE);
+        return (void *) -1;
+      }
+  for (upage = new_end; upage < old_end; upage += PGSIZE)
+    remove_heap_page (upage);
+
+  t->brk = new_brk;
+  return old_brk;
+}
+
+/* Adds a zeroed, writable page at UPAGE to the current process's
+   heap.  Returns true if successful, false if UPAGE is already
+   mapped or memory is not available. */
+static bool
+add_heap_page (void *upage)
+{
+#ifdef VM
+  return page_allocate (upage, true) != NULL;
+#else
+  uint8_t *kpage = palloc_get_colored_page (PAL_USER | PAL_ZERO, upage);
+  if (kpage == NULL)
+    return false;
+  if (!install_page (upage, kpage, true))
+    {
+      palloc_free_page (kpage);
+      return false;
+    }
+  return true;
+#endif
+}
+
+/* Removes the page at UPAGE from the current process's heap. */
+static void
+remove_heap_page (void *upage)
+{
+#ifdef VM
+  page_deallocate (upage);
+#else
+  struct thread *t = thread_current ();
+  void *kpage = pagedir_get_page (t->pagedir, upage);
+  pagedir_clear_page (t->pagedir, upage);
+  palloc_free_page (kpage);
+#endif
+}
 
 /* We load ELF binaries.  The following definitions are taken
    from the ELF specification, [ELF1], more-or-less verbatim.  */
 
 /* ELF types.  See [ELF1] 1-2. */
 typedef uint32_t Elf32_Word, Elf32_Addr, Elf32_Off;
+typedef int32_t Elf32_Sword;
 typedef uint16_t Elf32_Half;
 
 /* For use with ELF types in printf(). */
@@ -269,6 +600,10 @@ struct Elf32_Ehdr
     Elf32_Half    e_shstrndx;
   };
 
+/* Values for e_type.  See [ELF1] 1-3. */
+#define ET_EXEC 2       /* Executable file. */
+#define ET_DYN  3       /* Shared object file. */
+
 /* Program header.  See [ELF1] 2-2 to 2-4.
    There are e_phnum of these, starting at file offset e_phoff
    (see [ELF1] 1-6). */
@@ -299,7 +634,106 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
+/* Dynamic section entry.  See [ELF1] 2-9 to 2-14. */
+struct Elf32_Dyn
+  {
+    Elf32_Sword d_tag;
+    Elf32_Word  d_val;
+  };
+
+/* Values for d_tag.  See [ELF1] 2-10 to 2-13. */
+#define DT_NULL     0           /* End of dynamic section. */
+#define DT_NEEDED   1           /* Name of a needed library. */
+#define DT_PLTRELSZ 2           /* Size of PLT relocations. */
+#define DT_HASH     4           /* Symbol hash table. */
+#define DT_STRTAB   5           /* String table. */
+#define DT_SYMTAB   6           /* Symbol table. */
+#define DT_RELA     7           /* Relocations with addends. */
+#define DT_STRSZ    10          /* Size of string table. */
+#define DT_SYMENT   11          /* Size of a symbol table entry. */
+#define DT_REL      17          /* Relocations. */
+#define DT_RELSZ    18          /* Size of relocations. */
+#define DT_RELENT   19          /* Size of a relocation. */
+#define DT_PLTREL   20          /* Type of PLT relocations. */
+#define DT_TEXTREL  22          /* Relocations modify text. */
+#define DT_JMPREL   23          /* PLT relocations. */
+#define DT_FLAGS    30          /* Flags. */
+#define DF_TEXTREL  4           /* DT_FLAGS: relocations modify text. */
+
+/* Symbol table entry.  See [ELF1] 1-17 to 1-20. */
+struct Elf32_Sym
+  {
+    Elf32_Word    st_name;
+    Elf32_Addr    st_value;
+    Elf32_Word    st_size;
+    unsigned char st_info;
+    unsigned char st_other;
+    Elf32_Half    st_shndx;
+  };
+
+#define ELF32_ST_BIND(INFO) ((INFO) >> 4)
+#define STB_LOCAL 0             /* Not visible outside its object. */
+#define STB_WEAK  2             /* May stay undefined. */
+#define SHN_UNDEF 0             /* Undefined symbol. */
+
+/* Relocation entry.  See [ELF1] 1-21 to 1-22. */
+struct Elf32_Rel
+  {
+    Elf32_Addr r_offset;
+    Elf32_Word r_info;
+  };
+
+#define ELF32_R_SYM(INFO) ((INFO) >> 8)
+#define ELF32_R_TYPE(INFO) ((INFO) & 0xff)
+
+/* Relocation types.  See [ELF1] 1-23 and 2-17 to 2-18. */
+#define R_386_NONE     0        /* Nothing. */
+#define R_386_32       1        /* Symbol plus addend. */
+#define R_386_PC32     2        /* Symbol plus addend, PC-relative. */
+#define R_386_COPY     5        /* Copy symbol's initial value. */
+#define R_386_GLOB_DAT 6        /* GOT entry. */
+#define R_386_JMP_SLOT 7        /* PLT entry. */
+#define R_386_RELATIVE 8        /* Load address plus addend. */
+
+/* Most loadable segments in an object. */
+#define OBJ_SEG_MAX 8
+
+/* An ELF object being loaded into the current process: the
+   executable or one of the shared libraries that it needs.  Only
+   exists while load() runs.  All addresses in it are user
+   virtual addresses, already adjusted by BASE. */
+struct object
+  {
+    const char *name;           /* File name. */
+    struct file *file;          /* File. */
+    uint32_t base;              /* Load address of a library, 0 if none. */
+    uint32_t entry;             /* Entry point. */
+    uint32_t end;               /* Page just past the last segment. */
+
+    /* Loaded segments. */
+    struct segment
+      {
+        uint32_t start, end;    /* Address range. */
+        bool writable;          /* Writable? */
+      }
+    segs[OBJ_SEG_MAX];
+    size_t seg_cnt;
+
+    /* Dynamic section and the tables it points to.  DYNAMIC is 0
+       for a statically linked executable. */
+    uint32_t dynamic;           /* Dynamic section. */
+    uint32_t dynamic_size;      /* Its size in bytes. */
+    const Elf32_Word *hash;     /* Symbol hash table. */
+    const struct Elf32_Sym *symtab; /* Symbol table. */
+    const char *strtab;         /* String table. */
+    uint32_t strtab_size;       /* Its size in bytes. */
+    uint32_t rel, rel_size;     /* Relocations. */
+    uint32_t jmprel, jmprel_size; /* PLT relocations. */
+  };
+
 static bool setup_stack (void **esp);
+static bool load_object (struct object *, Elf32_Half type);
+static bool link_objects (struct object *objs, size_t *obj_cnt);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
@@ -308,21 +742,37 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 /* Loads an ELF executable from FILE_NAME into the current thread.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
-   Returns true if successful, false otherwise. */
+   Returns true if successful, false otherwise.
+
+   A dynamically linked executable is linked here, too, against
+   the shared libraries it needs, which are loaded from the root
+   directory starting at LIB_BASE. */
 bool
 load (const char *file_name, void (**eip) (void), void **esp)
 {
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
+  struct object *objs;
   struct file *file = NULL;
-  off_t file_ofs;
+  size_t obj_cnt = 1;
   bool success = false;
-  int i;
+
+  /* Objects to load: the executable, then its libraries. */
+  objs = calloc (LIB_MAX + 1, sizeof *objs);
+  if (objs == NULL)
+    goto done;
 
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
     goto done;
+#ifdef VM
+  if (!page_table_init ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+#endif
   process_activate ();
 
   /* Open executable file. */
@@ -334,18 +784,81 @@ load (const char *file_name, void (**eip) (void), void **esp)
     }
     
 
+  /* Load the executable and link it with its libraries. */
+  objs[0].name = file_name;
+  objs[0].file = file;
+  if (!load_object (&objs[0], ET_EXEC)
+      || (objs[0].dynamic != 0 && !link_objects (objs, &obj_cnt)))
+    goto done;
+
+  /* The heap starts out empty, just above the last segment. */
+  t->brk = t->brk_start = (uint8_t *) objs[0].end;
+
+  /* Set up stack. */
+  if (!setup_stack (esp))
+    goto done;
+
+  /* Start address. */
+  *eip = (void (*) (void)) objs[0].entry;
+
+  success = true;
+
+ done:
+  /* We arrive here whether the load is successful or not. */
+  free (objs);
+ if  (success) { file_deny_write(file); thread_current()->file=file;}
+  //else file_close (file);
+  return success;
+}
+
+/* load() helpers. */
+
+#ifndef VM
+static bool load_large_page (struct file *, uint8_t *upage,
+                             size_t read_bytes, bool writable);
+#endif
+
+static bool read_dynamic (struct object *);
+static bool load_library (struct object *objs, size_t *obj_cnt,
+                          const char *name);
+static bool relocate (struct object *objs, size_t obj_cnt,
+                      const struct object *, uint32_t rel, uint32_t size);
+static bool resolve (struct object *objs, size_t obj_cnt,
+                     const struct object *, uint32_t sym_idx, bool copy,
+                     uint32_t *value, uint32_t *size);
+static const struct Elf32_Sym *lookup (const struct object *,
+                                       const char *name, uint32_t hash);
+static const char *symbol_name (const struct object *,
+                                const struct Elf32_Sym *);
+static uint32_t elf_hash (const char *);
+static bool object_contains (const struct object *, uint32_t addr,
+                             uint32_t size, bool writable);
+
+/* Loads the segments of OBJ's file, which must be an ELF file of
+   the given TYPE, at OBJ->base, and records in OBJ where they
+   went, its entry point, and its dynamic section.  Returns true
+   if successful, false otherwise. */
+static bool
+load_object (struct object *obj, Elf32_Half type)
+{
+  struct Elf32_Ehdr ehdr;
+  off_t file_ofs;
+  int i;
+
   /* Read and verify executable header. */
-  if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+  if (file_read (obj->file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
-      || ehdr.e_type != 2
+      || ehdr.e_type != type
       || ehdr.e_machine != 3
       || ehdr.e_version != 1
       || ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
       || ehdr.e_phnum > 1024)
     {
-      printf ("load: %s: error loading executable\n", file_name);
-      goto done;
+      printf ("load: %s: error loading %s\n", obj->name,
+              type == ET_EXEC ? "executable" : "library");
+      return false;
     }
+  obj->entry = obj->base + ehdr.e_entry;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -353,12 +866,12 @@ load (const char *file_name, void (**eip) (void), void **esp)
     {
       struct Elf32_Phdr phdr;
 
-      if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
-      file_seek (file, file_ofs);
+      if (file_ofs < 0 || file_ofs > file_length (obj->file))
+        return false;
+      file_seek (obj->file, file_ofs);
 
-      if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+      if (file_read (obj->file, &phdr, sizeof phdr) != sizeof phdr)
+        return false;
       file_ofs += sizeof phdr;
       switch (phdr.p_type)
         {
@@ -366,16 +879,25 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_NOTE:
         case PT_PHDR:
         case PT_STACK:
+        case PT_INTERP:
         default:
-          /* Ignore this segment. */
+          /* Ignore this segment.  There is no dynamic loader to
+             run: we link the program ourselves. */
           break;
-        case PT_DYNAMIC:
-        case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          return false;
+        case PT_DYNAMIC:
+          obj->dynamic = obj->base + phdr.p_vaddr;
+          obj->dynamic_size = phdr.p_memsz;
+          break;
         case PT_LOAD:
-          if (validate_segment (&phdr, file))
+          if (obj->seg_cnt >= OBJ_SEG_MAX
+              || obj->base + phdr.p_vaddr < obj->base)
+            return false;
+          phdr.p_vaddr += obj->base;
+          if (validate_segment (&phdr, obj->file))
             {
+              struct segment *s = &obj->segs[obj->seg_cnt++];
               bool writable = (phdr.p_flags & PF_W) != 0;
               uint32_t file_page = phdr.p_offset & ~PGMASK;
               uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
@@ -396,35 +918,397 @@ load (const char *file_name, void (**eip) (void), void **esp)
                   read_bytes = 0;
                   zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
+              if (!load_segment (obj->file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
-                goto done;
+                return false;
+              s->start = phdr.p_vaddr;
+              s->end = phdr.p_vaddr + phdr.p_memsz;
+              s->writable = writable;
+              if (mem_page + read_bytes + zero_bytes > obj->end)
+                obj->end = mem_page + read_bytes + zero_bytes;
             }
           else
-            goto done;
+            return false;
           break;
         }
     }
+  return true;
+}
 
-  /* Set up stack. */
-  if (!setup_stack (esp))
-    goto done;
+/* Loads the shared libraries that OBJS[0], a dynamically linked
+   executable, needs, and those that they need in turn, adding
+   them to OBJS and incrementing *OBJ_CNT for each one.  Then
+   applies every object's relocations, resolving each symbol to
+   its first definition in the executable or the libraries, in
+   the order they were loaded.
+
+   Linking is done eagerly, all at once, so that there is no
+   lazy binding code to run in user mode.  Only the writable
+   segments are relocated: text that would need relocations is
+   refused, because it could not be shared among processes.
+   Libraries are linked before the executable, so that R_386_COPY
+   relocations in the executable copy initialized data.  Returns
+   true if successful, false otherwise. */
+static bool
+link_objects (struct object *objs, size_t *obj_cnt)
+{
+  size_t i;
 
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+  for (i = 0; i < *obj_cnt; i++)
+    {
+      struct object *obj = &objs[i];
+      const struct Elf32_Dyn *d;
+      size_t j;
 
-  success = true;
+      if (!read_dynamic (obj))
+        {
+          printf ("load: %s: bad dynamic section\n", obj->name);
+          return false;
+        }
+      d = (const struct Elf32_Dyn *) obj->dynamic;
+      for (j = 0; j < obj->dynamic_size / sizeof *d && d[j].d_tag != DT_NULL;
+           j++)
+        if (d[j].d_tag == DT_NEEDED)
+          {
+            const char *name = (d[j].d_val < obj->strtab_size
+                                ? obj->strtab + d[j].d_val : NULL);
+            if (name == NULL || !load_library (objs, obj_cnt, name))
+              return false;
+          }
+    }
 
- done:
-  /* We arrive here whether the load is successful or not. */
- if  (success) { file_deny_write(file); thread_current()->file=file;}
-  //else file_close (file);
-  return success;
+  for (i = *obj_cnt; i-- > 0; )
+    {
+      struct object *obj = &objs[i];
+
+      if (!relocate (objs, *obj_cnt, obj, obj->rel, obj->rel_size)
+          || !relocate (objs, *obj_cnt, obj, obj->jmprel, obj->jmprel_size))
+        return false;
+    }
+  return true;
 }
-
-/* load() helpers. */
 
-static bool install_page (void *upage, void *kpage, bool writable);
+/* Reads OBJ's dynamic section and checks that the tables it
+   points to lie within OBJ.  Returns true if successful, false
+   if the dynamic section is malformed or asks for something
+   that link_objects() does not support. */
+static bool
+read_dynamic (struct object *obj)
+{
+  const struct Elf32_Dyn *d = (const struct Elf32_Dyn *) obj->dynamic;
+  uint32_t hash = 0, symtab = 0, strtab = 0;
+  size_t i;
+
+  if (obj->dynamic == 0
+      || !object_contains (obj, obj->dynamic, obj->dynamic_size, false))
+    return false;
+  for (i = 0; i < obj->dynamic_size / sizeof *d && d[i].d_tag != DT_NULL; i++)
+    switch (d[i].d_tag)
+      {
+      case DT_HASH:
+        hash = obj->base + d[i].d_val;
+        break;
+      case DT_SYMTAB:
+        symtab = obj->base + d[i].d_val;
+        break;
+      case DT_STRTAB:
+        strtab = obj->base + d[i].d_val;
+        break;
+      case DT_STRSZ:
+        obj->strtab_size = d[i].d_val;
+        break;
+      case DT_REL:
+        obj->rel = obj->base + d[i].d_val;
+        break;
+      case DT_RELSZ:
+        obj->rel_size = d[i].d_val;
+        break;
+      case DT_JMPREL:
+        obj->jmprel = obj->base + d[i].d_val;
+        break;
+      case DT_PLTRELSZ:
+        obj->jmprel_size = d[i].d_val;
+        break;
+      case DT_SYMENT:
+        if (d[i].d_val != sizeof (struct Elf32_Sym))
+          return false;
+        break;
+      case DT_RELENT:
+        if (d[i].d_val != sizeof (struct Elf32_Rel))
+          return false;
+        break;
+      case DT_PLTREL:
+        if (d[i].d_val != DT_REL)
+          return false;
+        break;
+      case DT_FLAGS:
+        if (d[i].d_val & DF_TEXTREL)
+          return false;
+        break;
+      case DT_RELA:
+      case DT_TEXTREL:
+        return false;
+      }
+
+  /* The string table must end in a null terminator, so that
+     every string in it does.  The hash table's second word is
+     the number of symbols. */
+  if (!object_contains (obj, strtab, obj->strtab_size, false)
+      || obj->strtab_size == 0
+      || ((const char *) strtab)[obj->strtab_size - 1] != '\0'
+      || !object_contains (obj, hash, 2 * sizeof (Elf32_Word), false))
+    return false;
+  obj->strtab = (const char *) strtab;
+  obj->hash = (const Elf32_Word *) hash;
+  if (obj->hash[0] > 65536 || obj->hash[1] > 65536
+      || !object_contains (obj, hash, ((2 + obj->hash[0] + obj->hash[1])
+                                       * sizeof (Elf32_Word)), false)
+      || !object_contains (obj, symtab,
+                           obj->hash[1] * sizeof (struct Elf32_Sym), false))
+    return false;
+  obj->symtab = (const struct Elf32_Sym *) symtab;
+
+  return (obj->rel_size % sizeof (struct Elf32_Rel) == 0
+          && obj->jmprel_size % sizeof (struct Elf32_Rel) == 0
+          && (obj->rel_size == 0
+              || object_contains (obj, obj->rel, obj->rel_size, false))
+          && (obj->jmprel_size == 0
+              || object_contains (obj, obj->jmprel, obj->jmprel_size, false)));
+}
+
+/* Opens shared library NAME in the root directory, unless it is
+   already in OBJS, and loads it just past the last object in
+   OBJS, incrementing *OBJ_CNT.  The library stays open, and
+   denies writes, for as long as the process runs, because its
+   pages are read from it on demand.  Returns true if successful,
+   false otherwise. */
+static bool
+load_library (struct object *objs, size_t *obj_cnt, const char *name)
+{
+  struct thread *t = thread_current ();
+  struct object *lib;
+  char path[32];
+  size_t i;
+
+  for (i = 1; i < *obj_cnt; i++)
+    if (!strcmp (objs[i].name, name))
+      return true;
+  if (t->lib_cnt >= LIB_MAX || strchr (name, '/') != NULL
+      || strlen (name) + 2 > sizeof path)
+    {
+      printf ("load: %s: cannot load library\n", name);
+      return false;
+    }
+
+  lib = &objs[*obj_cnt];
+  lib->name = name;
+  lib->base = *obj_cnt == 1 ? LIB_BASE : objs[*obj_cnt - 1].end;
+  snprintf (path, sizeof path, "/%s", name);
+  lib->file = filesys_open (path);
+  if (lib->file == NULL)
+    {
+      printf ("load: %s: open failed\n", name);
+      return false;
+    }
+  if (inode_is_dir (file_get_inode (lib->file)))
+    {
+      dir_close ((struct dir *) lib->file);
+      printf ("load: %s: open failed\n", name);
+      return false;
+    }
+  t->libs[t->lib_cnt++] = lib->file;
+  file_deny_write (lib->file);
+
+  if (!load_object (lib, ET_DYN))
+    return false;
+  if (lib->dynamic == 0)
+    {
+      printf ("load: %s: error loading library\n", name);
+      return false;
+    }
+  (*obj_cnt)++;
+  return true;
+}
+
+/* Applies the SIZE bytes of relocations at REL to OBJ, one of
+   the OBJ_CNT objects in OBJS.  Returns true if successful, false
+   if a relocation is malformed or of an unsupported type or if
+   its symbol is undefined. */
+static bool
+relocate (struct object *objs, size_t obj_cnt, const struct object *obj,
+          uint32_t rel, uint32_t size)
+{
+  const struct Elf32_Rel *r = (const struct Elf32_Rel *) rel;
+  const struct Elf32_Rel *end = (const struct Elf32_Rel *) (rel + size);
+
+  for (; r < end; r++)
+    {
+      uint32_t type = ELF32_R_TYPE (r->r_info);
+      uint32_t sym_idx = ELF32_R_SYM (r->r_info);
+      uint32_t where = obj->base + r->r_offset;
+      uint32_t *p = (uint32_t *) where;
+      uint32_t value, sym_size;
+
+      if (type == R_386_NONE)
+        continue;
+      if (type == R_386_COPY)
+        {
+          if (!resolve (objs, obj_cnt, obj, sym_idx, true, &value, &sym_size)
+              || !object_contains (obj, where, sym_size, true))
+            return false;
+          memcpy (p, (const void *) value, sym_size);
+          continue;
+        }
+      if (!object_contains (obj, where, sizeof *p, true))
+        return false;
+      if (type != R_386_RELATIVE
+          && !resolve (objs, obj_cnt, obj, sym_idx, false, &value, &sym_size))
+        return false;
+
+      switch (type)
+        {
+        case R_386_RELATIVE:
+          *p += obj->base;
+          break;
+        case R_386_32:
+          *p += value;
+          break;
+        case R_386_PC32:
+          *p += value - where;
+          break;
+        case R_386_GLOB_DAT:
+        case R_386_JMP_SLOT:
+          *p = value;
+          break;
+        default:
+          printf ("load: %s: unsupported relocation type %"PRIu32"\n",
+                  obj->name, type);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Finds the definition of symbol SYM_IDX of OBJ, searching the
+   OBJ_CNT objects in OBJS in order, or only the libraries if
+   COPY is true, and stores its address into *VALUE and its size
+   into *SIZE.  An undefined weak symbol resolves to 0.  Returns
+   true if successful, false if the symbol is undefined or if
+   the definition found for COPY is not entirely within its
+   object. */
+static bool
+resolve (struct object *objs, size_t obj_cnt, const struct object *obj,
+         uint32_t sym_idx, bool copy, uint32_t *value, uint32_t *size)
+{
+  const struct Elf32_Sym *ref;
+  const char *name;
+  uint32_t hash;
+  size_t i;
+
+  *value = *size = 0;
+  if (sym_idx == 0)
+    return true;
+  if (sym_idx >= obj->hash[1])
+    return false;
+  ref = &obj->symtab[sym_idx];
+  name = symbol_name (obj, ref);
+  if (name == NULL)
+    return false;
+
+  hash = elf_hash (name);
+  for (i = copy ? 1 : 0; i < obj_cnt; i++)
+    {
+      const struct Elf32_Sym *def = lookup (&objs[i], name, hash);
+      if (def != NULL)
+        {
+          *value = objs[i].base + def->st_value;
+          *size = def->st_size;
+          return !copy || object_contains (&objs[i], *value, *size, false);
+        }
+    }
+  if (ELF32_ST_BIND (ref->st_info) == STB_WEAK)
+    return true;
+  printf ("load: %s: undefined symbol %s\n", obj->name, name);
+  return false;
+}
+
+/* Returns OBJ's global definition of the symbol called NAME,
+   whose elf_hash() is HASH, or a null pointer if OBJ does not
+   define it. */
+static const struct Elf32_Sym *
+lookup (const struct object *obj, const char *name, uint32_t hash)
+{
+  uint32_t nbucket = obj->hash[0];
+  uint32_t nchain = obj->hash[1];
+  const Elf32_Word *bucket = obj->hash + 2;
+  const Elf32_Word *chain = bucket + nbucket;
+  uint32_t i, steps;
+
+  if (nbucket == 0)
+    return NULL;
+
+  /* Don't follow more links than there are symbols, in case the
+     chain loops. */
+  for (i = bucket[hash % nbucket], steps = 0; i != 0 && i < nchain
+         && steps < nchain; i = chain[i], steps++)
+    {
+      const struct Elf32_Sym *s = &obj->symtab[i];
+      const char *s_name = symbol_name (obj, s);
+
+      if (s->st_shndx != SHN_UNDEF && ELF32_ST_BIND (s->st_info) != STB_LOCAL
+          && s_name != NULL && !strcmp (s_name, name))
+        return s;
+    }
+  return NULL;
+}
+
+/* Returns the name of symbol SYM in OBJ, or a null pointer if it
+   lies outside OBJ's string table. */
+static const char *
+symbol_name (const struct object *obj, const struct Elf32_Sym *sym)
+{
+  return sym->st_name < obj->strtab_size ? obj->strtab + sym->st_name : NULL;
+}
+
+/* Returns the hash of symbol NAME used by ELF hash tables.
+   See [ELF1] 2-19. */
+static uint32_t
+elf_hash (const char *name)
+{
+  uint32_t h = 0, g;
+
+  while (*name != '\0')
+    {
+      h = (h << 4) + (unsigned char) *name++;
+      g = h & 0xf0000000;
+      if (g != 0)
+        h ^= g >> 24;
+      h &= ~g;
+    }
+  return h;
+}
+
+/* Returns true if the SIZE bytes starting at user address ADDR
+   lie entirely within one of OBJ's loaded segments, which must
+   be writable if WRITABLE is true, false otherwise.  The kernel
+   only touches an object's tables and relocation targets after
+   checking them with this function, so that a malformed object
+   cannot make it fault on an unmapped or read-only page. */
+static bool
+object_contains (const struct object *obj, uint32_t addr, uint32_t size,
+                 bool writable)
+{
+  size_t i;
+
+  for (i = 0; i < obj->seg_cnt; i++)
+    {
+      const struct segment *s = &obj->segs[i];
+      if (addr >= s->start && addr <= s->end && size <= s->end - addr
+          && (s->writable || !writable))
+        return true;
+    }
+  return false;
+}
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -483,6 +1367,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only recorded in the supplemental page
+   table here; each is read in by the page fault handler the
+   first time the process touches it.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -502,8 +1390,35 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from. */
+      struct page *p = page_allocate (upage, writable);
+      if (p == NULL)
+        return false;
+      if (page_read_bytes > 0)
+        {
+          p->type = PAGE_FILE;
+          p->file = file;
+          p->file_ofs = ofs;
+          p->read_bytes = page_read_bytes;
+        }
+      ofs += page_read_bytes;
+#else
+      /* Map a whole, aligned 4 MB of the segment with one large
+         page, if asked to and if the memory is to be had. */
+      if (process_large_pages && (uintptr_t) upage % PTSPAN == 0
+          && read_bytes + zero_bytes >= PTSPAN
+          && load_large_page (file, upage, read_bytes, writable))
+        {
+          size_t large_read_bytes = read_bytes < PTSPAN ? read_bytes : PTSPAN;
+          read_bytes -= large_read_bytes;
+          zero_bytes -= PTSPAN - large_read_bytes;
+          upage += PTSPAN;
+          continue;
+        }
+
       /* Get a page of memory. */
-      uint8_t *kpage = palloc_get_page (PAL_USER);
+      uint8_t *kpage = palloc_get_colored_page (PAL_USER, upage);
       if (kpage == NULL)
         return false;
 
@@ -521,6 +1436,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false;
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -558,10 +1474,21 @@ setup_stack (void **esp)
   int j;
   int temp;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+#ifdef VM
+  /* The arguments are pushed right away, so bring the page in
+     now rather than through a page fault. */
+  kpage = NULL;
+  if (page_allocate (((uint8_t *) PHYS_BASE) - PGSIZE, true) != NULL)
+    success = page_load (((uint8_t *) PHYS_BASE) - PGSIZE, true);
+  if (success)
+    {
+#else
+  kpage = palloc_get_colored_page (PAL_USER | PAL_ZERO,
+                                   ((uint8_t *) PHYS_BASE) - PGSIZE);
   if (kpage != NULL)
     {
       success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+#endif
       if (success){
         struct list_elem *e;
         *esp = PHYS_BASE;
@@ -597,6 +1524,40 @@ setup_stack (void **esp)
   return success;
 }
 
+#ifndef VM
+/* Loads the 4 MB of a segment at user virtual address UPAGE, the
+   first READ_BYTES of which, or all of it if READ_BYTES is
+   larger, come from FILE at its current position, into a large
+   page.  Returns true if successful, false if there are no 4 MB
+   of aligned, contiguous free memory in the user pool or if
+   anything else goes wrong, in which case the caller should load
+   the same memory 4 kB at a time. */
+static bool
+load_large_page (struct file *file, uint8_t *upage, size_t read_bytes,
+                 bool writable)
+{
+  struct thread *t = thread_current ();
+  size_t page_cnt = PTSPAN / PGSIZE;
+  off_t ofs = file_tell (file);
+  uint8_t *kpage;
+
+  if (read_bytes > PTSPAN)
+    read_bytes = PTSPAN;
+
+  kpage = palloc_get_aligned (PAL_USER, page_cnt, page_cnt);
+  if (kpage == NULL)
+    return false;
+  if (file_read (file, kpage, read_bytes) == (off_t) read_bytes)
+    {
+      memset (kpage + read_bytes, 0, PTSPAN - read_bytes);
+      if (pagedir_set_large_page (t->pagedir, upage, kpage, writable))
+        return true;
+    }
+  file_seek (file, ofs);
+  palloc_free_multiple (kpage, page_cnt);
+  return false;
+}
+
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -615,4 +1576,5 @@ install_page (void *upage, void *kpage, bool writable)
      address, then map our page there. */
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -1,11 +1,22 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <stdint.h>
 #include "threads/thread.h"
 
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+void process_start_reaper (void);
+void process_reap (struct thread *);
+void *process_sbrk (intptr_t increment);
+#ifndef VM
+extern bool process_large_pages;
+#endif
+#ifdef VM
+struct intr_frame;
+tid_t process_fork (const struct intr_frame *);
+#endif
 
 #endif /* userprog/process.h */
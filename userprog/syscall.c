@@ -1,16 +1,24 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <vmstat.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "lib/kernel/list.h"
 #include <stdlib.h>
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
 #include "filesys/file.h" 
 #include "filesys/filesys.h" 
 #include <string.h>
 #include "devices/block.h"
+#include "devices/timer.h"
+#ifdef VM
+#include "vm/checkpoint.h"
+#include "vm/mmap.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
 
@@ -92,6 +100,22 @@ check_string2(uint8_t *start, int length){
     return true;
 }
 
+/* Copies SIZE bytes from SRC to user address UDST.
+   Returns true if successful, false if UDST is not wholly
+   writable user memory. */
+static bool
+copy_out (void *udst_, const void *src_, size_t size)
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if ((void *) (udst + i) >= PHYS_BASE || !put_user (udst + i, src[i]))
+      return false;
+  return true;
+}
+
 //GLOBAL static semaphore for file-sys
 static struct semaphore sema;
 
@@ -133,6 +157,12 @@ syscall_handler (struct intr_frame *f UNUSED)
         thread_current ()->c->status=-1;
         thread_exit(); 
         return;}
+#ifdef VM
+    /* A page fault while copying to or from user memory has the
+       kernel's ESP in its frame, so keep the user's for stack
+       growth. */
+    current->user_esp = f->esp;
+#endif
     switch(*call) {
         case SYS_HALT:
             shutdown_power_off();
@@ -381,6 +411,68 @@ case SYS_CHDIR:
             }
     f->eax=sys_inumber(fl->f);
     break;
+        case SYS_FORK:
+#ifdef VM
+            sema_down(&sema);
+            (f->eax) = process_fork(f);
+            sema_up(&sema);
+#else
+            (f->eax) = -1;
+#endif
+            break;
+        case SYS_VMSTAT:
+            {
+              struct vmstat st;
+              enum intr_level old_level UNUSED;
+              memset (&st, 0, sizeof st);
+#ifdef VM
+              st.page_faults = current->fault_cnt;
+              st.fault_around_pages = current->fault_around_cnt;
+              old_level = intr_disable ();
+              st.swap_ins = current->swap_in_cnt;
+              st.swap_outs = current->swap_out_cnt;
+              st.evictions = current->evict_cnt;
+              st.resident_pages = current->rss_cnt;
+              st.swapped_pages = current->swap_cnt;
+              intr_set_level (old_level);
+#endif
+              st.page_tables = pagedir_pt_cnt (current->pagedir);
+              st.ticks = timer_ticks ();
+              if (!copy_out ((void *) *(call + 1), &st, sizeof st)) {  printf("%s: exit(%d)\n", name, test);thread_current ()->c->status=-1;thread_exit(); }
+              (f->eax) = true;
+            }
+            break;
+        case SYS_SBRK:
+            (f->eax) = (uint32_t) process_sbrk ((intptr_t) *(call + 1));
+            break;
+        case SYS_CHECKPOINT:
+        case SYS_RESTORE:
+            if(!check_string((char *)*(call + 1))) {  printf("%s: exit(%d)\n", name, test);thread_current ()->c->status=-1;thread_exit(); }
+#ifdef VM
+            sema_down(&sema);
+            if (*call == SYS_CHECKPOINT)
+              (f->eax) = checkpoint_save ((const char *) *(call + 1), f);
+            else
+              (f->eax) = checkpoint_restore ((const char *) *(call + 1));
+            sema_up(&sema);
+#else
+            (f->eax) = -1;
+#endif
+            break;
+#ifdef VM
+        case SYS_MMAP:
+            sema_down(&sema);
+            fl = findFD(&(current->fdt), *(call + 1));
+            if(fl == NULL || inode_is_dir(file_get_inode(fl->f))) (f->eax) = -1;
+            else (f->eax) = mmap_map(fl->f, (void *) *(call + 2));
+            sema_up(&sema);
+            break;
+        case SYS_MUNMAP:
+            sema_down(&sema);
+            mmap_unmap(*(call + 1));
+            sema_up(&sema);
+            break;
+#endif
 
     }
 
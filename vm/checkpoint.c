@@ -0,0 +1,445 @@
+#include "vm/checkpoint.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/flags.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Process checkpoint and restore.
+
+   checkpoint_save() writes an image of the current process into
+   a new file: its registers at the system call, its heap bounds,
+   its current directory and open files, and the contents of its
+   address space, except for memory-mapped files, which are not
+   saved, just as fork() does not inherit them.
+
+   checkpoint_restore() starts a child of the current process
+   from an image.  The child resumes where the saved process left
+   off, except that its system call returns 1 instead of 0.  It
+   does not read its memory up front: each page that held data
+   becomes a PAGE_FILE page of the image, which stays open as the
+   child's executable, and is read in when first touched, like a
+   page of a newly loaded program.  Pages that were never written
+   come back as zero-fill pages.  Full read-only pages, such as
+   program text, are shared among all the processes restored from
+   one image by the frame table's text index.
+
+   The file system does not keep a name for an open file, so open
+   files and directories, and the current directory, are recorded
+   by inode number and position.  An image therefore still works
+   after a reboot, provided that the files it refers to have not
+   been removed in the meantime.
+
+   An image is laid out as follows: a struct ckpt_header, then
+   FD_CNT struct ckpt_fd records in descriptor order, then
+   PAGE_CNT struct ckpt_page records, then, starting at the next
+   page boundary, the contents of the pages that have any. */
+
+/* Identifies a checkpoint image. */
+#define CKPT_MAGIC 0x54504b43
+
+/* Image header. */
+struct ckpt_header
+  {
+    unsigned magic;             /* Always CKPT_MAGIC. */
+    char name[16];              /* Process name. */
+    struct intr_frame regs;     /* User registers. */
+    uint32_t brk_start;         /* Start of heap. */
+    uint32_t brk;               /* End of heap. */
+    block_sector_t cwd;         /* Current directory's inode, or 0. */
+    uint32_t fd_cnt;            /* Number of struct ckpt_fd. */
+    uint32_t page_cnt;          /* Number of struct ckpt_page. */
+  };
+
+/* An open file or directory in an image. */
+struct ckpt_fd
+  {
+    int fd;                     /* File descriptor. */
+    block_sector_t inumber;     /* Inode. */
+    off_t pos;                  /* File position. */
+  };
+
+/* A page in an image. */
+struct ckpt_page
+  {
+    uint32_t upage;             /* User virtual address. */
+    uint32_t writable;          /* Writable by the process? */
+    off_t data_ofs;             /* Offset of contents, 0 if all zeros. */
+  };
+
+/* Passed from checkpoint_restore() to start_restore(). */
+struct restore_info
+  {
+    struct ckpt_header header;  /* Image header. */
+    struct file *file;          /* Image. */
+    struct semaphore done;      /* Upped once the child is set up. */
+    bool success;               /* Was the child set up? */
+  };
+
+static thread_func start_restore NO_RETURN;
+static bool copy_page (struct page *, uint8_t *buf);
+static bool restore_fds (const struct ckpt_header *);
+static bool restore_pages (const struct ckpt_header *);
+static bool restore_cwd (const struct ckpt_header *);
+static bool write_at (struct file *, const void *, off_t size, off_t ofs);
+
+/* Writes an image of the current process, which made a system
+   call with user registers IF_, into a new file named FILE_NAME.
+   Returns 0 if successful, -1 if the file exists or cannot be
+   written. */
+int
+checkpoint_save (const char *file_name, const struct intr_frame *if_)
+{
+  struct thread *t = thread_current ();
+  struct ckpt_header h;
+  struct hash_iterator i;
+  struct list_elem *e;
+  struct file *file;
+  uint8_t *buf;
+  off_t rec_ofs, data_ofs;
+  bool ok = true;
+
+  memset (&h, 0, sizeof h);
+  h.magic = CKPT_MAGIC;
+  strlcpy (h.name, t->name, sizeof h.name);
+  h.regs = *if_;
+  h.regs.eax = 1;
+  h.brk_start = (uint32_t) t->brk_start;
+  h.brk = (uint32_t) t->brk;
+  h.cwd = t->dir != NULL ? inode_get_inumber (dir_get_inode (t->dir)) : 0;
+  h.fd_cnt = list_size (&t->fdt);
+  hash_first (&i, &t->pages);
+  while (hash_next (&i))
+    if (hash_entry (hash_cur (&i), struct page, hash_elem)->type != PAGE_MMAP)
+      h.page_cnt++;
+
+  buf = palloc_get_page (0);
+  if (buf == NULL)
+    return -1;
+  if (!filesys_create (file_name, 0, false))
+    {
+      palloc_free_page (buf);
+      return -1;
+    }
+  file = filesys_open (file_name);
+  if (file == NULL)
+    {
+      palloc_free_page (buf);
+      return -1;
+    }
+
+  /* Open files. */
+  rec_ofs = sizeof h;
+  for (e = list_begin (&t->fdt); ok && e != list_end (&t->fdt);
+       e = list_next (e))
+    {
+      struct fdesc *d = list_entry (e, struct fdesc, elem);
+      struct inode *inode = file_get_inode (d->f);
+      struct ckpt_fd r;
+
+      r.fd = d->fd;
+      r.inumber = inode_get_inumber (inode);
+      r.pos = inode_is_dir (inode) ? 0 : file_tell (d->f);
+      ok = write_at (file, &r, sizeof r, rec_ofs);
+      rec_ofs += sizeof r;
+    }
+
+  /* Pages, with their contents after all the records. */
+  data_ofs = ROUND_UP (rec_ofs + h.page_cnt * sizeof (struct ckpt_page),
+                       PGSIZE);
+  hash_first (&i, &t->pages);
+  while (ok && hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct ckpt_page r;
+
+      if (p->type == PAGE_MMAP)
+        continue;
+      r.upage = (uint32_t) p->upage;
+      r.writable = p->writable;
+      r.data_ofs = 0;
+      if (copy_page (p, buf))
+        {
+          r.data_ofs = data_ofs;
+          ok = write_at (file, buf, PGSIZE, data_ofs);
+          data_ofs += PGSIZE;
+        }
+      ok = ok && write_at (file, &r, sizeof r, rec_ofs);
+      rec_ofs += sizeof r;
+    }
+
+  ok = ok && write_at (file, &h, sizeof h, 0);
+  file_close (file);
+  palloc_free_page (buf);
+  if (!ok)
+    filesys_remove (file_name);
+  return ok ? 0 : -1;
+}
+
+/* Starts a new child process from the image in FILE_NAME.
+   Returns the new process's thread id, or TID_ERROR if the file
+   is not an image or the process cannot be set up. */
+tid_t
+checkpoint_restore (const char *file_name)
+{
+  struct restore_info info;
+  tid_t tid = TID_ERROR;
+
+  info.file = filesys_open (file_name);
+  if (info.file == NULL)
+    return TID_ERROR;
+  if (inode_is_dir (file_get_inode (info.file)))
+    {
+      dir_close ((struct dir *) info.file);
+      return TID_ERROR;
+    }
+  if (file_read_at (info.file, &info.header, sizeof info.header, 0)
+      == sizeof info.header
+      && info.header.magic == CKPT_MAGIC)
+    {
+      info.header.name[sizeof info.header.name - 1] = '\0';
+      sema_init (&info.done, 0);
+      info.success = false;
+      tid = thread_create (info.header.name, PRI_DEFAULT, start_restore,
+                           &info);
+      if (tid != TID_ERROR)
+        {
+          sema_down (&info.done);
+          if (!info.success)
+            tid = TID_ERROR;
+        }
+    }
+  file_close (info.file);
+  return tid;
+}
+
+/* A thread function that sets up a process from an image and
+   starts it running. */
+static void
+start_restore (void *info_)
+{
+  struct restore_info *info = info_;
+  const struct ckpt_header *h = &info->header;
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto fail;
+  if (!page_table_init ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto fail;
+    }
+  process_activate ();
+
+  t->file = file_reopen (info->file);
+  if (t->file == NULL)
+    goto fail;
+  file_deny_write (t->file);
+  if (h->brk_start < PGSIZE || h->brk < h->brk_start
+      || !is_user_vaddr ((void *) h->brk))
+    goto fail;
+  t->brk_start = (uint8_t *) h->brk_start;
+  t->brk = (uint8_t *) h->brk;
+  if (!restore_pages (h) || !restore_fds (h) || !restore_cwd (h))
+    goto fail;
+
+  /* Take only the general registers from the image; the rest
+     are set as for a new process, so that an image cannot give
+     the process kernel privileges. */
+  memset (&if_, 0, sizeof if_);
+  if_.edi = h->regs.edi;
+  if_.esi = h->regs.esi;
+  if_.ebp = h->regs.ebp;
+  if_.ebx = h->regs.ebx;
+  if_.edx = h->regs.edx;
+  if_.ecx = h->regs.ecx;
+  if_.eax = h->regs.eax;
+  if_.eip = h->regs.eip;
+  if_.esp = h->regs.esp;
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+
+  /* INFO lives on the parent's stack, so it is gone once the
+     parent wakes up. */
+  info->success = true;
+  sema_up (&info->done);
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+
+ fail:
+  t->c->status = -1;
+  sema_up (&info->done);
+  thread_exit ();
+}
+
+/* Copies the contents of page P, which belongs to the current
+   process, into BUF, unless P was never written and so holds
+   nothing but zeros.  Returns true if it copied P, false if P is
+   all zeros. */
+static bool
+copy_page (struct page *p, uint8_t *buf)
+{
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+      bool zero = frame_is_zero (f);
+
+      if (!zero)
+        memcpy (buf, f->kpage, PGSIZE);
+      frame_unlock (f);
+      return !zero;
+    }
+  if (p->type == PAGE_ZERO)
+    return false;
+
+  /* Let the page fault handler bring the page in. */
+  memcpy (buf, p->upage, PGSIZE);
+  return true;
+}
+
+/* Reopens the files and directories that H's image records as
+   open, under the same descriptors and, for files, at the same
+   positions.  Returns true if successful, false if one of them
+   no longer exists or memory allocation fails. */
+static bool
+restore_fds (const struct ckpt_header *h)
+{
+  struct thread *t = thread_current ();
+  off_t ofs = sizeof *h;
+  int last_fd = 1;
+  uint32_t i;
+
+  for (i = 0; i < h->fd_cnt; i++)
+    {
+      struct ckpt_fd r;
+      struct inode *inode;
+      struct fdesc *d;
+
+      /* Descriptors must be in increasing order, as in every
+         file descriptor table. */
+      if (file_read_at (t->file, &r, sizeof r, ofs) != sizeof r
+          || r.fd <= last_fd || r.pos < 0 || !inode_exists (r.inumber))
+        return false;
+      ofs += sizeof r;
+      last_fd = r.fd;
+
+      d = malloc (sizeof *d);
+      if (d == NULL)
+        return false;
+      inode = inode_open (r.inumber);
+      if (inode != NULL && inode_is_dir (inode))
+        d->f = (struct file *) dir_open (inode);
+      else
+        {
+          d->f = file_open (inode);
+          if (d->f != NULL)
+            file_seek (d->f, r.pos);
+        }
+      if (d->f == NULL)
+        {
+          free (d);
+          return false;
+        }
+      d->fd = r.fd;
+      list_push_back (&t->fdt, &d->elem);
+    }
+  return true;
+}
+
+/* Adds the pages that H's image records to the current process's
+   supplemental page table, backed by the image or zero-filled.
+   Returns true if successful, false if a record is malformed or
+   memory allocation fails. */
+static bool
+restore_pages (const struct ckpt_header *h)
+{
+  struct thread *t = thread_current ();
+  off_t ofs = sizeof *h + h->fd_cnt * sizeof (struct ckpt_fd);
+  off_t length = file_length (t->file);
+  uint32_t i;
+
+  for (i = 0; i < h->page_cnt; i++)
+    {
+      struct ckpt_page r;
+      struct page *p;
+
+      if (file_read_at (t->file, &r, sizeof r, ofs) != sizeof r
+          || pg_ofs ((void *) r.upage) != 0 || r.upage < PGSIZE
+          || !is_user_vaddr ((void *) r.upage)
+          || r.data_ofs < 0 || r.data_ofs % PGSIZE != 0
+          || r.data_ofs > length - PGSIZE)
+        return false;
+      ofs += sizeof r;
+
+      p = page_allocate ((void *) r.upage, r.writable);
+      if (p == NULL)
+        return false;
+      if (r.data_ofs != 0)
+        {
+          p->type = PAGE_FILE;
+          p->file = t->file;
+          p->file_ofs = r.data_ofs;
+          p->read_bytes = PGSIZE;
+        }
+    }
+  return true;
+}
+
+/* Makes the directory that H's image records as current the
+   current process's current directory, instead of the one it
+   inherited from its parent.  Returns true if successful, false
+   if it no longer exists. */
+static bool
+restore_cwd (const struct ckpt_header *h)
+{
+  struct thread *t = thread_current ();
+  struct inode *inode;
+
+  dir_close (t->dir);
+  t->dir = NULL;
+  if (h->cwd == 0)
+    t->dir = dir_open_root ();
+  else
+    {
+      if (!inode_exists (h->cwd))
+        return false;
+      inode = inode_open (h->cwd);
+      if (inode != NULL && !inode_is_dir (inode))
+        {
+          inode_close (inode);
+          return false;
+        }
+      t->dir = dir_open (inode);
+    }
+  return t->dir != NULL;
+}
+
+/* Writes SIZE bytes from BUF into FILE at offset OFS.  Returns
+   true if successful, false if the file could not be extended. */
+static bool
+write_at (struct file *file, const void *buf, off_t size, off_t ofs)
+{
+  return file_write_at (file, buf, size, ofs) == size;
+}
@@ -0,0 +1,11 @@
+#ifndef VM_CHECKPOINT_H
+#define VM_CHECKPOINT_H
+
+#include "threads/thread.h"
+
+struct intr_frame;
+
+int checkpoint_save (const char *file_name, const struct intr_frame *);
+tid_t checkpoint_restore (const char *file_name);
+
+#endif /* vm/checkpoint.h */
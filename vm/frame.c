@@ -0,0 +1,790 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Frame table.
+
+   Every user pool page that holds a user page has an entry here.
+   When the user pool runs dry, frame_alloc_and_lock() picks a
+   frame to reuse with the second-chance "clock" algorithm: it
+   sweeps a hand around the table, giving each frame whose pages
+   have been accessed since the last sweep another chance, and
+   evicts the first frame whose pages have not.
+
+   Each frame has a lock, held by whoever is reading the frame's
+   pages in or writing them out or changing which pages share the
+   frame.  The evicting thread holds it from the moment it picks
+   the frame until the frame holds its new page, so a process
+   that faults on a page being evicted waits for the eviction to
+   finish and then brings the page back in.
+
+   A thread may wait for a frame's lock while that frame is
+   evicted, given to another process's page, and released by that
+   process, so released frames are kept on a free list for reuse
+   instead of being freed.
+
+   Evicting a frame, especially one that must be written to swap
+   first, is slow, so a page-out daemon keeps some user pool pages
+   free ahead of need.  It wakes up when the number of free pages
+   falls below PAGEOUT_LOW and evicts frames with the same clock
+   until there are PAGEOUT_HIGH free pages again or nothing more
+   can be evicted.  A process that finds the pool empty anyway
+   evicts a frame itself.
+
+   Processes running the same program often hold many pages with
+   identical contents: zeroed pages, initialized data, lookup
+   tables.  If frame_merge_pages is nonzero, a merging thread
+   scans that many frames every MERGE_INTERVAL timer ticks,
+   checksumming each one.  A frame whose checksum is the same as
+   at its last scan is entered in an index keyed on checksum, and
+   when another frame with the same checksum turns out to hold
+   the same bytes, its pages move into the indexed frame and are
+   shared copy-on-write, exactly as after fork(), and the emptied
+   frame is freed.  Frames whose contents keep changing never
+   reach the index, and frames of memory-mapped files and of
+   shared executable text are left alone.
+
+   The zero frame, a page of zeros that PAGE_ZERO pages map
+   read-only until they are first written, is not part of the
+   frame table, so it is never evicted, merged, or freed.
+
+   Read-only pages of executables are shared among all the
+   processes that run the same executable.  A frame that holds
+   one is entered in an index keyed on inode and offset, and the
+   next process to fault on the same page attaches to the frame
+   instead of reading another copy.  file_deny_write() keeps the
+   executable from changing while any process runs it, and the
+   frame leaves the index when it is evicted or when its last
+   page is released, so the index never outlives the
+   executable's contents. */
+
+/* List of all frames. */
+static struct list frames;
+
+/* Frames whose pages have been returned to the user pool. */
+static struct list free_frames;
+
+/* Protects frames, free_frames, and hand.  Never waited for
+   while a frame lock is held, except in frame_free(). */
+static struct lock scan_lock;
+
+/* Zero frame. */
+static struct frame zero_frame;
+
+/* Clock hand: the next frame to consider for eviction. */
+static struct list_elem *hand;
+
+/* Free page watermarks for the page-out daemon. */
+#define PAGEOUT_LOW 16
+#define PAGEOUT_HIGH 48
+
+/* Upped to wake the page-out daemon. */
+static struct semaphore pageout_sema;
+
+/* True while the page-out daemon is awake.  Protected by
+   scan_lock. */
+static bool pageout_running;
+
+/* -ksm: Frames to scan for pages to merge per pass. */
+size_t frame_merge_pages;
+
+/* Timer ticks between passes of the merging thread. */
+#define MERGE_INTERVAL (TIMER_FREQ / 10)
+
+/* Frames whose contents held still between two scans, keyed on
+   merge_sum.  Protected by scan_lock. */
+static struct hash merge_index;
+
+/* The next frame for the merging thread to scan.  Protected by
+   scan_lock. */
+static struct list_elem *merge_hand;
+
+/* Statistics. */
+static long long eviction_cnt;
+static long long pageout_cnt, pageout_wakeups;
+static long long merge_scan_cnt, merge_page_cnt, merge_frame_cnt;
+
+/* Index of frames that hold executable text, keyed on inode and
+   offset. */
+static struct hash text_frames;
+
+/* Text sharing statistics for one executable. */
+struct text_stats
+  {
+    block_sector_t inumber;     /* Executable's inode number. */
+    char name[16];              /* Name of the first process to run it. */
+    long long read_cnt;         /* Text pages read from disk. */
+    long long shared_cnt;       /* Text pages found already in memory. */
+    struct list_elem elem;      /* Element in text_stats. */
+  };
+static struct list text_stats;
+
+/* Protects text_frames and text_stats. */
+static struct lock text_lock;
+
+static bool get_free_frame (struct page *, struct frame **);
+static struct frame *evict_frame (void);
+static struct frame *next_frame (void);
+static void release_frame (struct frame *);
+static void count_resident (struct page *, int delta);
+static thread_func pageout_daemon NO_RETURN;
+static thread_func merge_daemon NO_RETURN;
+static void merge_frame (struct frame *);
+static void unindex_frame (struct frame *);
+static void unshare_text (struct frame *);
+static void count_text (struct inode *, bool shared);
+static hash_hash_func text_hash;
+static hash_less_func text_less;
+static hash_hash_func merge_hash;
+static hash_less_func merge_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  list_init (&free_frames);
+  lock_init (&scan_lock);
+  hand = NULL;
+
+  zero_frame.kpage = palloc_get_page (PAL_ZERO);
+  if (zero_frame.kpage == NULL)
+    PANIC ("frame: out of memory for zero frame");
+  list_init (&zero_frame.pages);
+  zero_frame.ref_cnt = 0;
+  lock_init (&zero_frame.lock);
+  zero_frame.text_inode = NULL;
+  zero_frame.merge_indexed = false;
+
+  if (!hash_init (&text_frames, text_hash, text_less, NULL)
+      || !hash_init (&merge_index, merge_hash, merge_less, NULL))
+    PANIC ("frame: out of memory for frame indexes");
+  merge_hand = NULL;
+  list_init (&text_stats);
+  lock_init (&text_lock);
+  sema_init (&pageout_sema, 0);
+}
+
+/* Starts the page-out daemon. */
+void
+frame_start_pageout (void)
+{
+  if (thread_create ("pageout", PRI_DEFAULT, pageout_daemon, NULL)
+      == TID_ERROR)
+    PANIC ("frame: cannot start page-out daemon");
+}
+
+/* Starts the merging thread, if merging is enabled. */
+void
+frame_start_merging (void)
+{
+  if (frame_merge_pages != 0
+      && thread_create ("merge", PRI_DEFAULT, merge_daemon, NULL)
+         == TID_ERROR)
+    PANIC ("frame: cannot start merging thread");
+}
+
+/* Obtains a frame for page P, evicting some other pages if the
+   user pool is exhausted, attaches P to it, and returns it
+   locked.  The caller fills the frame and then calls
+   frame_unlock().  Returns a null pointer if no frame can be
+   obtained, either because every frame is in use by pages that
+   cannot be evicted just now or because swap is full, and notes
+   the failure in the current thread for the out-of-memory
+   killer. */
+struct frame *
+frame_alloc_and_lock (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&scan_lock);
+
+  /* Use a free page if there is one. */
+  if (get_free_frame (p, &f))
+    {
+      lock_release (&scan_lock);
+      return f;
+    }
+
+  /* Otherwise evict. */
+  f = evict_frame ();
+  if (f != NULL)
+    frame_attach (f, p);
+  else
+    thread_current ()->out_of_frames = true;
+  return f;
+}
+
+/* Like frame_alloc_and_lock(), but only uses a free page of the
+   user pool, never evicting, so that reading a page ahead of
+   need does not push out a page that is needed. */
+struct frame *
+frame_try_alloc_and_lock (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&scan_lock);
+  get_free_frame (p, &f);
+  lock_release (&scan_lock);
+  return f;
+}
+
+/* Tries to take a free page from the user pool for page P.  If
+   there is none, returns false.  Otherwise, returns true and
+   sets *FP to a frame for the page, with P attached, locked, or
+   to a null pointer if memory allocation fails.  The caller must
+   hold scan_lock. */
+static bool
+get_free_frame (struct page *p, struct frame **fp)
+{
+  struct frame *f;
+  void *kpage;
+
+  *fp = NULL;
+  kpage = palloc_get_colored_page (PAL_USER, p->upage);
+  if (palloc_free_cnt (PAL_USER) < PAGEOUT_LOW && !pageout_running)
+    {
+      pageout_running = true;
+      pageout_wakeups++;
+      sema_up (&pageout_sema);
+    }
+  if (kpage == NULL)
+    return false;
+
+  if (!list_empty (&free_frames))
+    f = list_entry (list_pop_front (&free_frames), struct frame, elem);
+  else
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return true;
+        }
+      list_init (&f->pages);
+      f->ref_cnt = 0;
+      lock_init (&f->lock);
+      f->text_inode = NULL;
+      f->merge_indexed = false;
+    }
+  f->merge_sum = 0;
+  lock_acquire (&f->lock);
+  f->kpage = kpage;
+  frame_attach (f, p);
+  list_push_back (&frames, &f->elem);
+  *fp = f;
+  return true;
+}
+
+/* Picks a frame whose pages have not been accessed recently,
+   writes its pages out, and returns it, empty and locked.  A
+   frame that cannot be written out because swap is full is
+   skipped, so that a clean or file-backed frame further on can
+   still be evicted.  Returns a null pointer if no frame can be
+   evicted, because every frame is locked, in use, or needs swap
+   that is not available.  The caller must hold scan_lock, which
+   is released. */
+static struct frame *
+evict_frame (void)
+{
+  struct frame *f;
+  size_t scan_cnt, i;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+
+  /* Two trips around the clock are enough to find a frame whose
+     pages have not been accessed, unless every frame is
+     locked. */
+  scan_cnt = 2 * list_size (&frames);
+  for (i = 0; i < scan_cnt && !list_empty (&frames); i++)
+    {
+      f = next_frame ();
+      if (!lock_try_acquire (&f->lock))
+        continue;
+      if (page_accessed_recently (f))
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+
+      lock_release (&scan_lock);
+      if (!page_out (f))
+        {
+          lock_release (&f->lock);
+          lock_acquire (&scan_lock);
+          continue;
+        }
+      unshare_text (f);
+      eviction_cnt++;
+      return f;
+    }
+
+  lock_release (&scan_lock);
+  return NULL;
+}
+
+/* Page-out daemon.  Each time it is woken, evicts frames until
+   PAGEOUT_HIGH user pool pages are free, so that page faults
+   find a free page without waiting for a page to be written
+   out. */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct frame *f;
+
+      sema_down (&pageout_sema);
+      do
+        {
+          lock_acquire (&scan_lock);
+          if (palloc_free_cnt (PAL_USER) >= PAGEOUT_HIGH)
+            {
+              lock_release (&scan_lock);
+              break;
+            }
+          f = evict_frame ();
+          if (f != NULL)
+            {
+              frame_free (f);
+              pageout_cnt++;
+            }
+        }
+      while (f != NULL);
+
+      lock_acquire (&scan_lock);
+      pageout_running = false;
+      lock_release (&scan_lock);
+    }
+}
+
+/* Locks the frame that holds page P, if it has one, preventing
+   it from being evicted or merged until frame_unlock() is
+   called.  If P's frame is being evicted, waits for the eviction
+   to finish, after which P has no frame.  If it is being merged
+   into another frame, waits for the merge and then locks the
+   frame that P ended up in. */
+void
+frame_lock (struct page *p)
+{
+  /* F may have been evicted and given to some other page, or
+     even released, or P may have moved to another frame, by the
+     time we get it. */
+  struct frame *f;
+
+  while ((f = p->frame) != NULL)
+    {
+      lock_acquire (&f->lock);
+      if (f == p->frame)
+        break;
+      lock_release (&f->lock);
+    }
+}
+
+/* Unlocks frame F, allowing it to be evicted. */
+void
+frame_unlock (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Adds page P to the pages held in frame F, which the caller
+   must have locked. */
+void
+frame_attach (struct frame *f, struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == NULL);
+
+  list_push_back (&f->pages, &p->frame_elem);
+  f->ref_cnt++;
+  p->frame = f;
+  if (f != &zero_frame)
+    count_resident (p, 1);
+}
+
+/* Removes page P from the pages held in frame F, which the
+   caller must have locked. */
+void
+frame_detach (struct frame *f, struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == f);
+
+  list_remove (&p->frame_elem);
+  f->ref_cnt--;
+  p->frame = NULL;
+  if (f != &zero_frame)
+    count_resident (p, -1);
+}
+
+/* Adds DELTA to the number of resident pages of page P's
+   process.  The evicting thread updates the count as well as the
+   process itself, so interrupts are turned off. */
+static void
+count_resident (struct page *p, int delta)
+{
+  enum intr_level old_level = intr_disable ();
+  p->thread->rss_cnt += delta;
+  intr_set_level (old_level);
+}
+
+/* Locks and returns the zero frame, a page of zeros that is
+   never evicted or freed.  Pages attached to it must be mapped
+   read-only and must never modify it. */
+struct frame *
+frame_lock_zero (void)
+{
+  lock_acquire (&zero_frame.lock);
+  return &zero_frame;
+}
+
+/* Returns true if F is the zero frame. */
+bool
+frame_is_zero (const struct frame *f)
+{
+  return f == &zero_frame;
+}
+
+/* Releases frame F, which the caller must have locked and which
+   must no longer hold any pages, and returns its page to the
+   user pool. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->ref_cnt == 0);
+  ASSERT (!frame_is_zero (f));
+
+  unshare_text (f);
+  lock_acquire (&scan_lock);
+  release_frame (f);
+  lock_release (&scan_lock);
+
+  lock_release (&f->lock);
+}
+
+/* Takes frame F, which must be empty and out of the text index,
+   out of the frame table, returns its page to the user pool, and
+   puts it on the free list.  The caller must hold scan_lock and
+   F's lock. */
+static void
+release_frame (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->ref_cnt == 0 && f->text_inode == NULL);
+
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  if (merge_hand == &f->elem)
+    merge_hand = list_next (merge_hand);
+  unindex_frame (f);
+  list_remove (&f->elem);
+  palloc_free_page (f->kpage);
+  f->kpage = NULL;
+  list_push_back (&free_frames, &f->elem);
+}
+
+/* Merging thread.  Every MERGE_INTERVAL ticks, scans the next
+   frame_merge_pages frames of the frame table for pages that can
+   share a frame. */
+static void
+merge_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      size_t i;
+
+      timer_sleep (MERGE_INTERVAL);
+      lock_acquire (&scan_lock);
+      for (i = 0; i < frame_merge_pages && !list_empty (&frames); i++)
+        {
+          struct frame *f;
+
+          if (merge_hand == NULL || merge_hand == list_end (&frames))
+            merge_hand = list_begin (&frames);
+          f = list_entry (merge_hand, struct frame, elem);
+          merge_hand = list_next (merge_hand);
+          merge_frame (f);
+        }
+      lock_release (&scan_lock);
+    }
+}
+
+/* Scans frame F for merging: if F's contents have not changed
+   since it was last scanned, merges F's pages into an indexed
+   frame with the same contents or, if there is none, enters F in
+   the index.  Skips F if it is locked.  The caller must hold
+   scan_lock. */
+static void
+merge_frame (struct frame *f)
+{
+  struct hash_elem *e;
+  struct frame *g;
+  unsigned sum;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+
+  if (!lock_try_acquire (&f->lock))
+    return;
+  merge_scan_cnt++;
+  if (f->ref_cnt == 0 || f->text_inode != NULL || !page_mergeable (f))
+    goto done;
+
+  /* A page that changed since the last scan is likely to change
+     again soon, so wait for it to hold still. */
+  sum = hash_bytes (f->kpage, PGSIZE);
+  if (sum != f->merge_sum)
+    {
+      unindex_frame (f);
+      f->merge_sum = sum;
+      goto done;
+    }
+  if (f->merge_indexed)
+    goto done;
+
+  e = hash_find (&merge_index, &f->merge_elem);
+  if (e == NULL)
+    {
+      hash_insert (&merge_index, &f->merge_elem);
+      f->merge_indexed = true;
+      goto done;
+    }
+
+  /* G's contents may have changed since G was indexed, and F's
+     since we checksummed it, so compare them for real, once
+     neither can change any more. */
+  g = hash_entry (e, struct frame, merge_elem);
+  if (!lock_try_acquire (&g->lock))
+    goto done;
+  page_write_protect (f);
+  page_write_protect (g);
+  if (g->ref_cnt > 0 && memcmp (f->kpage, g->kpage, PGSIZE) == 0)
+    {
+      merge_page_cnt += f->ref_cnt;
+      merge_frame_cnt++;
+      page_merge (g, f);
+      lock_release (&g->lock);
+      release_frame (f);
+      lock_release (&f->lock);
+      return;
+    }
+  lock_release (&g->lock);
+
+ done:
+  lock_release (&f->lock);
+}
+
+/* Takes frame F out of the merge index, if it is in it.  The
+   caller must hold scan_lock. */
+static void
+unindex_frame (struct frame *f)
+{
+  if (f->merge_indexed)
+    {
+      hash_delete (&merge_index, &f->merge_elem);
+      f->merge_indexed = false;
+    }
+}
+
+/* Returns the frame that holds the page at offset OFS in
+   executable INODE, locked, or a null pointer if no frame holds
+   it.  Counts the lookup as a hit or a miss for INODE. */
+struct frame *
+frame_lookup_text (struct inode *inode, off_t ofs)
+{
+  struct frame key;
+  struct hash_elem *e;
+  struct frame *f;
+
+  key.text_inode = inode;
+  key.text_ofs = ofs;
+  lock_acquire (&text_lock);
+  e = hash_find (&text_frames, &key.text_elem);
+  f = e != NULL ? hash_entry (e, struct frame, text_elem) : NULL;
+  lock_release (&text_lock);
+
+  /* F cannot be waited for while holding text_lock, because an
+     evicting thread that holds F's lock acquires text_lock to
+     take F out of the index.  Instead, make sure that F still
+     holds the page once we have it. */
+  if (f != NULL)
+    {
+      lock_acquire (&f->lock);
+      if (f->text_inode != inode || f->text_ofs != ofs || f->ref_cnt == 0)
+        {
+          lock_release (&f->lock);
+          f = NULL;
+        }
+    }
+  count_text (inode, f != NULL);
+  return f;
+}
+
+/* Enters frame F, which the caller must have locked and which
+   holds the page at offset OFS in executable INODE, into the
+   text index, so that other processes running INODE share it.
+   Does nothing if another frame already holds the same page. */
+void
+frame_share_text (struct frame *f, struct inode *inode, off_t ofs)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->text_inode == NULL);
+
+  f->text_inode = inode;
+  f->text_ofs = ofs;
+  lock_acquire (&text_lock);
+  if (hash_insert (&text_frames, &f->text_elem) != NULL)
+    f->text_inode = NULL;
+  lock_release (&text_lock);
+  if (f->text_inode != NULL)
+    inode_reopen (inode);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  struct list_elem *e;
+
+  printf ("Frame: %zu frames, %lld evictions, %lld by page-out daemon "
+          "in %lld wakeups\n",
+          list_size (&frames), eviction_cnt, pageout_cnt, pageout_wakeups);
+  if (frame_merge_pages != 0)
+    printf ("Frame: %lld frames scanned for merging, %lld pages merged, "
+            "%lld frames (%lld kB) saved\n",
+            merge_scan_cnt, merge_page_cnt, merge_frame_cnt,
+            merge_frame_cnt * (PGSIZE / 1024));
+  for (e = list_begin (&text_stats); e != list_end (&text_stats);
+       e = list_next (e))
+    {
+      struct text_stats *ts = list_entry (e, struct text_stats, elem);
+      printf ("Frame: text of %s: %lld pages read, %lld pages shared\n",
+              ts->name, ts->read_cnt, ts->shared_cnt);
+    }
+}
+
+/* Advances the clock hand and returns the frame it passed.  The
+   frame table must not be empty. */
+static struct frame *
+next_frame (void)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+  ASSERT (!list_empty (&frames));
+
+  if (hand == NULL || hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Takes frame F, which the caller must have locked and which
+   must no longer hold any pages, out of the text index. */
+static void
+unshare_text (struct frame *f)
+{
+  struct inode *inode = f->text_inode;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->ref_cnt == 0);
+
+  if (inode == NULL)
+    return;
+  lock_acquire (&text_lock);
+  hash_delete (&text_frames, &f->text_elem);
+  lock_release (&text_lock);
+  f->text_inode = NULL;
+  inode_close (inode);
+}
+
+/* Counts a text page of executable INODE that was SHARED with
+   another process or, if SHARED is false, read from disk. */
+static void
+count_text (struct inode *inode, bool shared)
+{
+  block_sector_t inumber = inode_get_inumber (inode);
+  struct text_stats *ts = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&text_lock);
+  for (e = list_begin (&text_stats); e != list_end (&text_stats);
+       e = list_next (e))
+    if (list_entry (e, struct text_stats, elem)->inumber == inumber)
+      {
+        ts = list_entry (e, struct text_stats, elem);
+        break;
+      }
+  if (ts == NULL)
+    {
+      ts = calloc (1, sizeof *ts);
+      if (ts != NULL)
+        {
+          ts->inumber = inumber;
+          strlcpy (ts->name, thread_name (), sizeof ts->name);
+          list_push_back (&text_stats, &ts->elem);
+        }
+    }
+  if (ts != NULL)
+    {
+      if (shared)
+        ts->shared_cnt++;
+      else
+        ts->read_cnt++;
+    }
+  lock_release (&text_lock);
+}
+
+/* Returns a hash value for the text page held in the frame that
+   E refers to. */
+static unsigned
+text_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, text_elem);
+  return hash_bytes (&f->text_inode, sizeof f->text_inode) ^ f->text_ofs;
+}
+
+/* Returns true if the text page held in frame A precedes the one
+   in frame B. */
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, text_elem);
+  const struct frame *b = hash_entry (b_, struct frame, text_elem);
+
+  if (a->text_inode != b->text_inode)
+    return a->text_inode < b->text_inode;
+  return a->text_ofs < b->text_ofs;
+}
+
+/* Returns a hash value for the frame that E refers to, in the
+   merge index. */
+static unsigned
+merge_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct frame, merge_elem)->merge_sum);
+}
+
+/* Returns true if frame A's checksum is less than frame B's. */
+static bool
+merge_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct frame, merge_elem)->merge_sum
+          < hash_entry (b, struct frame, merge_elem)->merge_sum);
+}
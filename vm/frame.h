@@ -0,0 +1,57 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct inode;
+struct page;
+
+/* A frame: a page of the user pool that holds a user page.
+   After fork, the same page of several processes may share one
+   frame copy-on-write until one of them writes to it, and the
+   same read-only page of an executable may be shared by every
+   process running it. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages held in this frame. */
+    size_t ref_cnt;             /* Number of elements in `pages'. */
+    struct lock lock;           /* Held while paging in or out. */
+    struct list_elem elem;      /* Element in frame table. */
+
+    /* Shared executable text. */
+    struct inode *text_inode;   /* Executable, or a null pointer. */
+    off_t text_ofs;             /* Offset of the page in TEXT_INODE. */
+    struct hash_elem text_elem; /* Element in text page index. */
+
+    /* Same-page merging. */
+    unsigned merge_sum;         /* Checksum of contents at last scan. */
+    bool merge_indexed;         /* In merge index? */
+    struct hash_elem merge_elem; /* Element in merge index. */
+  };
+
+/* Number of frames to scan for pages to merge per pass, or 0 to
+   disable merging. */
+extern size_t frame_merge_pages;
+
+void frame_init (void);
+void frame_start_pageout (void);
+void frame_start_merging (void);
+struct frame *frame_alloc_and_lock (struct page *);
+struct frame *frame_try_alloc_and_lock (struct page *);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+struct frame *frame_lock_zero (void);
+bool frame_is_zero (const struct frame *);
+void frame_attach (struct frame *, struct page *);
+void frame_detach (struct frame *, struct page *);
+void frame_free (struct frame *);
+struct frame *frame_lookup_text (struct inode *, off_t);
+void frame_share_text (struct frame *, struct inode *, off_t);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
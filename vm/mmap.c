@@ -0,0 +1,122 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   Mapping a file adds one PAGE_MMAP page to the process's
+   supplemental page table for each page of the file.  Nothing is
+   read until the process touches a page, at which point the
+   page fault handler reads the page straight from the file into
+   the frame that the process will use, without a copy through a
+   kernel buffer.  Modified pages are written back when they are
+   evicted, when the file is unmapped, and when the process
+   exits. */
+
+static void unmap (struct mapping *);
+
+/* Maps FILE into the current process's address space starting at
+   ADDR, which must be page-aligned and not 0, and returns a
+   mapping identifier.  Returns -1 if FILE is empty, if the
+   mapping would overlap pages already in the address space or
+   extend past PHYS_BASE, or if memory allocation fails.  The
+   mapping uses its own reopened copy of FILE, so it is
+   unaffected if the process closes FILE. */
+int
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return -1;
+  length = file_length (file);
+  if (length == 0)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  m->base = addr;
+  m->page_cnt = 0;
+
+  while (m->page_cnt < (size_t) DIV_ROUND_UP (length, PGSIZE))
+    {
+      off_t ofs = m->page_cnt * PGSIZE;
+      uint8_t *upage = m->base + ofs;
+      struct page *p;
+
+      p = is_user_vaddr (upage) ? page_allocate (upage, true) : NULL;
+      if (p == NULL)
+        {
+          unmap (m);
+          return -1;
+        }
+      p->type = PAGE_MMAP;
+      p->file = m->file;
+      p->file_ofs = ofs;
+      p->read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      m->page_cnt++;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Unmaps the current process's mapping with identifier ID, if
+   there is one, writing back the pages that it modified. */
+void
+mmap_unmap (int id)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        {
+          list_remove (&m->elem);
+          unmap (m);
+          return;
+        }
+    }
+}
+
+/* Unmaps all of the current process's mappings. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_pop_front (&t->mappings),
+                       struct mapping, elem));
+}
+
+/* Removes the pages of mapping M, which is not on any list, from
+   the current process's address space, then frees M. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_deallocate (m->base + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
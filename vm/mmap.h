@@ -0,0 +1,24 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct file;
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    int id;                     /* Mapping identifier. */
+    struct file *file;          /* Mapped file, reopened. */
+    uint8_t *base;              /* First mapped page. */
+    size_t page_cnt;            /* Number of pages mapped. */
+    struct list_elem elem;      /* Element in thread's `mappings'. */
+  };
+
+int mmap_map (struct file *, void *addr);
+void mmap_unmap (int id);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,152 @@
+#include "vm/oom.h"
+#include <debug.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Out-of-memory killer.
+
+   When a page fault cannot get a frame, because every frame is
+   locked or swap is full, the faulting process used to die,
+   although it was usually not the process that used up memory.
+   Instead, the process that holds the most memory, resident and
+   in swap, is chosen and killed.  If that is the faulting
+   process, it dies as before.  Otherwise, the faulting process
+   waits for the victim to exit and retries the access.
+
+   Another thread cannot simply be destroyed, because it may be
+   in the middle of a system call, so the victim is only marked.
+   It exits the next time it returns from the kernel to user
+   mode, which happens at its next system call, page fault, or
+   timer interrupt.  A victim that stays in the kernel for
+   OOM_WAIT timer ticks, perhaps waiting for a lock that the
+   faulting process holds, is left to exit when it can, and the
+   faulting process dies instead of killing anyone else. */
+
+/* Timer ticks to wait for a victim to exit. */
+#define OOM_WAIT TIMER_FREQ
+
+/* Number of processes killed. */
+static long long kill_cnt;
+
+/* The process holding the most memory. */
+struct victim
+  {
+    struct thread *thread;      /* Process, or a null pointer. */
+    size_t pages;               /* Its resident and swapped pages. */
+  };
+
+/* A thread to look for. */
+struct search
+  {
+    tid_t tid;                  /* Thread identifier. */
+    bool found;                 /* Does the thread still exist? */
+  };
+
+static thread_action_func find_victim;
+static thread_action_func find_thread;
+
+/* Kills the process holding the most memory, because a page
+   fault by the current process could not get a frame.  Returns
+   true if the victim was another process and it has exited, so
+   that the faulting access should be retried, false if the
+   current process should die. */
+bool
+oom_kill (void)
+{
+  struct victim v;
+  struct search s;
+  char name[sizeof v.thread->name];
+  size_t rss, swap;
+  enum intr_level old_level;
+  int i;
+
+  v.thread = NULL;
+  v.pages = 0;
+  old_level = intr_disable ();
+  thread_foreach (find_victim, &v);
+  if (v.thread == NULL)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  v.thread->oom_killed = true;
+  s.tid = v.thread->tid;
+  rss = v.thread->rss_cnt;
+  swap = v.thread->swap_cnt;
+  memcpy (name, v.thread->name, sizeof name);
+  intr_set_level (old_level);
+
+  kill_cnt++;
+  printf ("oom: %s needed a page; killed %s (tid %d): "
+          "%zu pages resident, %zu in swap\n",
+          thread_name (), name, s.tid, rss, swap);
+  if (s.tid == thread_tid ())
+    return false;
+
+  for (i = 0; i < OOM_WAIT; i++)
+    {
+      timer_sleep (1);
+      s.found = false;
+      old_level = intr_disable ();
+      thread_foreach (find_thread, &s);
+      intr_set_level (old_level);
+      if (!s.found)
+        return true;
+    }
+  return false;
+}
+
+/* Makes the current process exit if it was killed to free
+   memory.  Called on the way back to user mode. */
+void
+oom_exit_if_killed (void)
+{
+  struct thread *t = thread_current ();
+
+  if (!t->oom_killed)
+    return;
+  intr_enable ();
+  if (t->c != NULL)
+    t->c->status = -1;
+  printf ("%s: exit(%d)\n", thread_name (), -1);
+  thread_exit ();
+}
+
+/* Prints out-of-memory killer statistics. */
+void
+oom_print_stats (void)
+{
+  printf ("OOM: %lld processes killed\n", kill_cnt);
+}
+
+/* thread_foreach() callback for oom_kill().  Makes T the victim
+   if it is a user process that has not already been killed and
+   holds more memory than the victim so far. */
+static void
+find_victim (struct thread *t, void *v_)
+{
+  struct victim *v = v_;
+  size_t pages = t->rss_cnt + t->swap_cnt;
+
+  if (t->pagedir != NULL && !t->oom_killed
+      && (v->thread == NULL || pages > v->pages))
+    {
+      v->thread = t;
+      v->pages = pages;
+    }
+}
+
+/* thread_foreach() callback for oom_kill().  Notes in S whether
+   T is the thread that S looks for. */
+static void
+find_thread (struct thread *t, void *s_)
+{
+  struct search *s = s_;
+
+  if (t->tid == s->tid)
+    s->found = true;
+}
@@ -0,0 +1,10 @@
+#ifndef VM_OOM_H
+#define VM_OOM_H
+
+#include <stdbool.h>
+
+bool oom_kill (void);
+void oom_exit_if_killed (void);
+void oom_print_stats (void);
+
+#endif /* vm/oom.h */
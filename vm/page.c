@@ -0,0 +1,864 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   load() no longer reads a program's segments into memory up
+   front.  Instead, it records each page of each segment here,
+   along with where its contents come from, and the page fault
+   handler brings a page in the first time the process touches
+   it.  Pages that are never touched are never read.  Pages
+   evicted by the frame table are brought back the same way.
+
+   A PAGE_ZERO page that is first touched by a read is not given
+   a frame of its own: it is mapped read-only to the zero frame,
+   shared by every such page in every process, and gets a frame
+   of its own on its first write, through page_unshare().  Large
+   arrays in bss that are read before they are written, or never
+   written at all, then cost no memory. */
+
+/* Maximum size of a process's stack, in pages: 8 MB by default.
+   setup_stack() maps only the top page; the rest is added by
+   page_grow_stack() as the stack grows down into it. */
+size_t page_stack_limit = 2048;
+
+/* -fault-around: Number of pages, aligned on a multiple of the
+   same, around a fault on a file-backed page that are mapped
+   along with it.  0 or 1 maps only the faulting page. */
+size_t page_fault_around = 16;
+
+/* -rss: Maximum number of resident pages per process, or 0 for
+   no limit.  A process at its limit evicts one of its own pages
+   to make room for another, instead of taking a frame from some
+   other process. */
+size_t page_rss_limit;
+
+/* Number of pages added by page_grow_stack(). */
+static long long stack_growth_cnt;
+
+/* Number of pages read from swap ahead of a fault. */
+static long long readahead_cnt;
+
+/* Number of pages mapped to the zero frame, and number of those
+   later written. */
+static long long zero_map_cnt, zero_copy_cnt;
+
+/* Number of pages evicted by processes at their RSS limit. */
+static long long rss_evict_cnt;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func destroy_page;
+static void release_page (struct page *);
+static void swap_in_ahead (struct page *, struct frame *);
+static void fault_around (struct page *);
+static void count_swapped (struct page *, int delta);
+static void count_evicted (struct page *, bool swapped);
+static bool over_rss_limit (void);
+static void trim_rss (void);
+
+/* Initializes the current process's supplemental page table.
+   Returns true if successful, false if memory allocation
+   fails. */
+bool
+page_table_init (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Destroys the current process's supplemental page table,
+   releasing the frames and swap slots that hold its pages.  Must
+   be called while the process's page directory still exists,
+   because an eviction in progress may still refer to it. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, destroy_page);
+}
+
+/* Returns the current process's copy of FILE, which is PARENT's
+   executable or one of its shared libraries. */
+static struct file *
+inherited_file (struct thread *parent, struct file *file)
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  for (i = 0; i < parent->lib_cnt; i++)
+    if (parent->libs[i] == file)
+      return t->libs[i];
+  return t->file;
+}
+
+/* Copies PARENT's address space into the current process, whose
+   supplemental page table must be empty, for fork().  Resident
+   pages come to share their frames with PARENT, and evicted
+   pages their swap slots, copy-on-write.  Memory-mapped files
+   are not inherited.  PAGE_FILE pages are read from the current
+   process's own executable and shared libraries, which must
+   already be open, in the same order as PARENT's.  PARENT
+   must not run until the copy is complete.  Returns true if
+   successful, false if memory allocation fails. */
+bool
+page_table_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *cp;
+
+      if (pp->type == PAGE_MMAP)
+        continue;
+      cp = page_allocate (pp->upage, pp->writable);
+      if (cp == NULL)
+        return false;
+
+      /* Allocating can sleep, and so can locking PP's frame, while
+         the page-out daemon evicts PP and changes its type.  Copy
+         PP's backing store only once its frame is locked, or once
+         PP has none, so that it cannot change any more. */
+      frame_lock (pp);
+      cp->type = pp->type;
+      cp->file = (pp->type == PAGE_FILE
+                  ? inherited_file (parent, pp->file) : NULL);
+      cp->file_ofs = pp->file_ofs;
+      cp->read_bytes = pp->read_bytes;
+      if (pp->frame != NULL)
+        {
+          /* Share the frame read-only.  The child inherits the
+             parent's dirty bit, because the frame's contents
+             differ from the page's backing store for the child
+             just as much as for the parent. */
+          struct frame *f = pp->frame;
+          bool ok = pagedir_set_page (t->pagedir, cp->upage, f->kpage, false);
+          if (ok)
+            {
+              pagedir_set_dirty (t->pagedir, cp->upage,
+                                 pagedir_is_dirty (parent->pagedir,
+                                                   pp->upage));
+              pagedir_set_writable (parent->pagedir, pp->upage, false);
+              frame_attach (f, cp);
+            }
+          frame_unlock (f);
+          if (!ok)
+            return false;
+        }
+      else if (pp->type == PAGE_SWAP)
+        {
+          cp->swap_slot = pp->swap_slot;
+          swap_dup (cp->swap_slot);
+          count_swapped (cp, 1);
+        }
+    }
+  return true;
+}
+
+/* Adds a page at user virtual address UPAGE to the current
+   process's address space, initially to be filled with zeros,
+   and returns it.  The page is writable by the process if
+   WRITABLE is true.  Returns a null pointer if UPAGE is already
+   part of the address space or if memory allocation fails. */
+struct page *
+page_allocate (void *upage, bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->upage = upage;
+  p->thread = thread_current ();
+  p->writable = writable;
+  p->frame = NULL;
+  p->type = PAGE_ZERO;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  p->swap_slot = SWAP_ERROR;
+
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Removes the page at user virtual address UPAGE from the
+   current process's address space.  A PAGE_MMAP page that the
+   process modified is written back to its file first. */
+void
+page_deallocate (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (&thread_current ()->pages, &p->hash_elem);
+  release_page (p);
+}
+
+/* Returns the page of the current process's address space that
+   contains user virtual address ADDR, or a null pointer if ADDR
+   is not part of the address space. */
+struct page *
+page_lookup (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  if (t->pagedir == NULL || !is_user_vaddr (addr))
+    return NULL;
+
+  p.upage = pg_round_down (addr);
+  e = hash_find (&t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Obtains a frame for page P and fills it from P's backing
+   store.  If MAY_EVICT is false, uses only a free frame, never
+   evicting another page.  On success, returns true with P's
+   frame locked. */
+static bool
+do_page_in (struct page *p, bool may_evict)
+{
+  struct frame *f;
+  uint8_t *kpage;
+
+  /* A whole read-only page of the executable may already be in
+     memory for another process running it. */
+  bool text = p->type == PAGE_FILE && !p->writable && p->read_bytes == PGSIZE;
+  if (text)
+    {
+      f = frame_lookup_text (file_get_inode (p->file), p->file_ofs);
+      if (f != NULL)
+        {
+          frame_attach (f, p);
+          return true;
+        }
+    }
+
+  f = may_evict ? frame_alloc_and_lock (p) : frame_try_alloc_and_lock (p);
+  if (f == NULL)
+    return false;
+  kpage = f->kpage;
+
+  /* The read does not take the file system lock in syscall.c,
+     because the fault may have been raised by a system call that
+     already holds it while copying to or from user memory. */
+  switch (p->type)
+    {
+    case PAGE_ZERO:
+      memset (kpage, 0, PGSIZE);
+      break;
+
+    case PAGE_FILE:
+    case PAGE_MMAP:
+      if (file_read_at (p->file, kpage, p->read_bytes, p->file_ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_detach (f, p);
+          frame_free (f);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+      if (text)
+        frame_share_text (f, file_get_inode (p->file), p->file_ofs);
+      break;
+
+    case PAGE_SWAP:
+      swap_in_ahead (p, f);
+      break;
+    }
+  return true;
+}
+
+/* Reads page P, a PAGE_SWAP page of the current process, from
+   swap into frame F, which holds P and is locked.  The pages
+   that follow P in the address space are often the next to be
+   needed, and if they were evicted along with P they sit in the
+   swap slots that follow P's, so read as many of those as there
+   are free frames for in the same request.  They are left
+   unmapped until the process touches them. */
+static void
+swap_in_ahead (struct page *p, struct frame *f)
+{
+  struct page *pages[SWAP_READAHEAD];
+  void *kpages[SWAP_READAHEAD];
+  size_t cnt, i;
+
+  pages[0] = p;
+  kpages[0] = f->kpage;
+  for (cnt = 1; cnt < SWAP_READAHEAD; cnt++)
+    {
+      /* Only the owning process brings its pages in, so Q cannot
+         gain a frame behind our back, and a Q without a frame is
+         no longer being evicted. */
+      struct page *q = page_lookup ((uint8_t *) p->upage + cnt * PGSIZE);
+      struct frame *qf;
+
+      if (q == NULL || q->type != PAGE_SWAP || q->frame != NULL
+          || q->swap_slot != p->swap_slot + cnt || over_rss_limit ())
+        break;
+      qf = frame_try_alloc_and_lock (q);
+      if (qf == NULL)
+        break;
+      pages[cnt] = q;
+      kpages[cnt] = qf->kpage;
+    }
+
+  swap_in_multiple (p->swap_slot, kpages, cnt);
+  p->thread->swap_in_cnt += cnt;
+  p->swap_slot = SWAP_ERROR;
+  count_swapped (p, -1);
+  for (i = 1; i < cnt; i++)
+    {
+      pages[i]->swap_slot = SWAP_ERROR;
+      count_swapped (pages[i], -1);
+      frame_unlock (pages[i]->frame);
+    }
+  readahead_cnt += cnt - 1;
+}
+
+/* Brings in the page that contains FAULT_ADDR, which the current
+   process tried to access, writing if WRITE is true: obtains a
+   frame, fills it from the page's backing store, and maps it
+   into the page directory.  A PAGE_ZERO page that is only being
+   read is mapped to the zero frame instead.  Returns true if
+   successful, false if FAULT_ADDR is not part of the address
+   space or if no frame can be had or a disk read fails. */
+bool
+page_load (const void *fault_addr, bool write)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (fault_addr);
+  struct frame *f;
+  bool success;
+
+  if (p == NULL)
+    return false;
+
+  if (p->frame == NULL)
+    trim_rss ();
+  frame_lock (p);
+  if (p->frame == NULL)
+    {
+      if (p->type == PAGE_ZERO && !write)
+        {
+          frame_attach (frame_lock_zero (), p);
+          zero_map_cnt++;
+        }
+      else if (!do_page_in (p, true))
+        return false;
+    }
+  f = p->frame;
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  success = pagedir_set_page (t->pagedir, p->upage, f->kpage,
+                              (p->writable && f->ref_cnt == 1
+                               && !frame_is_zero (f)));
+  frame_unlock (f);
+
+  if (success && (p->type == PAGE_FILE || p->type == PAGE_MMAP))
+    fault_around (p);
+  return success;
+}
+
+/* Maps the neighbours of file-backed page P, which the current
+   process just faulted in, so that a process that walks through
+   its code or a mapped file does not fault on every page.
+
+   The neighbours are the other pages in P's aligned window of
+   page_fault_around pages that continue the same segment or
+   mapping: pages of the same file, at the same distance in the
+   file as in memory.  A neighbour that is already in memory is
+   mapped as is, and one that is not is read in only if a free
+   frame is available for it, so fault-around never evicts. */
+static void
+fault_around (struct page *p)
+{
+  struct thread *t = thread_current ();
+  uint8_t *start;
+  size_t i;
+
+  if (page_fault_around <= 1)
+    return;
+
+  start = ((uint8_t *) p->upage
+           - pg_no (p->upage) % page_fault_around * PGSIZE);
+  for (i = 0; i < page_fault_around; i++)
+    {
+      uint8_t *upage = start + i * PGSIZE;
+      off_t delta = upage - (uint8_t *) p->upage;
+      struct page *q = page_lookup (upage);
+      struct frame *f;
+
+      if (over_rss_limit ())
+        break;
+      if (q == NULL || q == p || q->type != p->type || q->file != p->file
+          || q->file_ofs != p->file_ofs + delta || q->writable != p->writable
+          || pagedir_get_page (t->pagedir, upage) != NULL)
+        continue;
+
+      frame_lock (q);
+      if (q->frame == NULL && !do_page_in (q, false))
+        continue;
+      f = q->frame;
+      if (pagedir_set_page (t->pagedir, q->upage, f->kpage,
+                            q->writable && f->ref_cnt == 1))
+        t->fault_around_cnt++;
+      frame_unlock (f);
+    }
+}
+
+/* Handles a fault by the current process at FAULT_ADDR, which is
+   not part of its address space, as a possible access to its
+   stack.  ESP is the process's stack pointer at the time.
+
+   The access counts as a stack access if it is within the
+   process's stack limit below PHYS_BASE and no more than 32
+   bytes below ESP, the most that PUSHA pushes before it updates
+   the stack pointer; anything farther down is a stray pointer.
+   In that case, adds a zeroed, writable page there and brings it
+   in.  Returns true if successful, false if FAULT_ADDR is not a
+   stack access or if the page cannot be added. */
+bool
+page_grow_stack (const void *fault_addr, const void *esp)
+{
+  const uint8_t *addr = fault_addr;
+  void *upage = pg_round_down (fault_addr);
+
+  if (thread_current ()->pagedir == NULL
+      || !is_user_vaddr (addr)
+      || (size_t) ((uint8_t *) PHYS_BASE - addr) > page_stack_limit * PGSIZE
+      || addr + 32 < (const uint8_t *) esp)
+    return false;
+
+  if (page_allocate (upage, true) == NULL)
+    return false;
+  if (!page_load (upage, true))
+    {
+      page_deallocate (upage);
+      return false;
+    }
+  stack_growth_cnt++;
+  return true;
+}
+
+/* Handles a write by the current process to the present but
+   read-only page that contains FAULT_ADDR.  If the page is
+   writable but shares its frame copy-on-write, gives the page a
+   frame of its own, copied from the shared one; if it is the
+   frame's last user, just makes it writable.  A page mapped to
+   the zero frame always gets a frame of its own.  Returns true if
+   successful, false if the page is not writable or no frame can
+   be had. */
+bool
+page_unshare (const void *fault_addr)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (fault_addr);
+  struct frame *old, *new;
+
+  if (p == NULL || !p->writable)
+    return false;
+
+  /* Only the current process detaches its pages from the zero
+     frame, so this test cannot go stale. */
+  if (p->frame != NULL && frame_is_zero (p->frame))
+    trim_rss ();
+  frame_lock (p);
+  old = p->frame;
+  if (old == NULL)
+    {
+      /* Evicted since the fault.  Retrying the write will bring
+         the page back in. */
+      return true;
+    }
+
+  if (frame_is_zero (old))
+    {
+      /* The zero frame is never evicted and never changes, so
+         there is no need to keep other processes from faulting
+         on it while we wait for a frame. */
+      frame_detach (old, p);
+      frame_unlock (old);
+      new = frame_alloc_and_lock (p);
+      if (new == NULL)
+        {
+          old = frame_lock_zero ();
+          frame_attach (old, p);
+          frame_unlock (old);
+          return false;
+        }
+      memset (new->kpage, 0, PGSIZE);
+      zero_copy_cnt++;
+    }
+  else if (old->ref_cnt == 1)
+    {
+      pagedir_set_writable (t->pagedir, p->upage, true);
+      frame_unlock (old);
+      return true;
+    }
+  else
+    {
+      /* OLD stays locked, so it cannot be evicted while we copy
+         it. */
+      frame_detach (old, p);
+      new = frame_alloc_and_lock (p);
+      if (new == NULL)
+        {
+          frame_attach (old, p);
+          frame_unlock (old);
+          return false;
+        }
+      memcpy (new->kpage, old->kpage, PGSIZE);
+      frame_unlock (old);
+    }
+
+  /* Point the mapping at the copy in place, rather than clearing
+     and setting it, which could free its page table and then
+     fail to allocate it again. */
+  pagedir_remap_page (t->pagedir, p->upage, new->kpage);
+  pagedir_set_writable (t->pagedir, p->upage, true);
+  frame_unlock (new);
+  return true;
+}
+
+/* Evicts the pages held in frame F, which the caller must have
+   locked: unmaps them and, if their contents would otherwise be
+   lost, writes the contents back to their file or to swap.  Pages
+   that shared F share its swap slot.  Returns true if
+   successful, false if swap is full, in which case the pages
+   stay resident. */
+bool
+page_out (struct frame *f)
+{
+  struct list_elem *e;
+  struct page *p;
+  bool dirty = false;
+  bool private = false;
+  size_t slot = SWAP_ERROR;
+  bool first_ref = true;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->ref_cnt > 0);
+
+  /* Unmap first, so that no process can modify the frame behind
+     our back. */
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      p = list_entry (e, struct page, frame_elem);
+      dirty |= pagedir_clear_page (p->thread->pagedir, p->upage);
+      private |= p->type == PAGE_SWAP;
+    }
+
+  p = list_entry (list_front (&f->pages), struct page, frame_elem);
+  if (p->type == PAGE_MMAP)
+    {
+      if (dirty)
+        file_write_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
+    }
+  else if (dirty || private)
+    {
+      slot = swap_out (f->kpage);
+      if (slot == SWAP_ERROR)
+        {
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            {
+              uint32_t *pd;
+
+              p = list_entry (e, struct page, frame_elem);
+              pd = p->thread->pagedir;
+              if (pagedir_set_page (pd, p->upage, f->kpage,
+                                    p->writable && f->ref_cnt == 1))
+                pagedir_set_dirty (pd, p->upage, dirty);
+              else if (dirty && p->type != PAGE_SWAP)
+                {
+                  /* Clearing P freed its page table, which cannot
+                     be had again.  P stays in F, to be mapped on
+                     its next fault, but must not lose its changes
+                     along with its dirty bit. */
+                  p->type = PAGE_SWAP;
+                  p->swap_slot = SWAP_ERROR;
+                }
+            }
+          return false;
+        }
+    }
+
+  while (!list_empty (&f->pages))
+    {
+      p = list_entry (list_front (&f->pages), struct page, frame_elem);
+      if (slot != SWAP_ERROR)
+        {
+          p->type = PAGE_SWAP;
+          p->swap_slot = slot;
+          count_swapped (p, 1);
+          if (!first_ref)
+            swap_dup (slot);
+          first_ref = false;
+        }
+      count_evicted (p, slot != SWAP_ERROR);
+      frame_detach (f, p);
+    }
+  return true;
+}
+
+/* Returns true if any page held in frame F, which the caller must
+   have locked, has been accessed since the last call for F, and
+   clears their accessed bits. */
+bool
+page_accessed_recently (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Returns true if the pages held in frame F, which the caller
+   must have locked, could share a frame with other pages that
+   have the same contents: that is, if none of them is part of a
+   memory-mapped file, whose frame stands for the file itself. */
+bool
+page_mergeable (struct frame *f)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (list_entry (e, struct page, frame_elem)->type == PAGE_MMAP)
+      return false;
+  return true;
+}
+
+/* Makes every page held in frame F, which the caller must have
+   locked, read-only, so that F's contents cannot change until it
+   is unlocked.  A process that writes to one of them afterward
+   faults into page_unshare(), which makes it writable again if
+   it is still F's only page. */
+void
+page_write_protect (struct frame *f)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      pagedir_set_writable (p->thread->pagedir, p->upage, false);
+    }
+}
+
+/* Moves every page held in frame SRC to frame DST, which must
+   have the same contents, leaving SRC empty.  The caller must
+   have locked both frames and write-protected DST's pages.  The
+   moved pages are mapped read-only, so DST is shared
+   copy-on-write just as after fork(), and keep their dirty
+   bits.  Pages that SRC held but had not mapped stay
+   unmapped. */
+void
+page_merge (struct frame *dst, struct frame *src)
+{
+  ASSERT (lock_held_by_current_thread (&dst->lock));
+  ASSERT (lock_held_by_current_thread (&src->lock));
+  ASSERT (dst != src);
+
+  while (!list_empty (&src->pages))
+    {
+      struct page *p = list_entry (list_front (&src->pages),
+                                   struct page, frame_elem);
+      pagedir_remap_page (p->thread->pagedir, p->upage, dst->kpage);
+      frame_detach (src, p);
+      frame_attach (dst, p);
+    }
+}
+
+/* Adds DELTA to the number of swapped-out pages of page P's
+   process.  The evicting thread updates the count as well as the
+   process itself, so interrupts are turned off. */
+static void
+count_swapped (struct page *p, int delta)
+{
+  enum intr_level old_level = intr_disable ();
+  p->thread->swap_cnt += delta;
+  intr_set_level (old_level);
+}
+
+/* Counts the eviction of page P, which was SWAPPED out or else
+   dropped or written back to its file, for P's process.  As for
+   count_swapped(), interrupts are turned off. */
+static void
+count_evicted (struct page *p, bool swapped)
+{
+  enum intr_level old_level = intr_disable ();
+  p->thread->evict_cnt++;
+  if (swapped)
+    p->thread->swap_out_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current process has as many resident
+   pages as page_rss_limit allows. */
+static bool
+over_rss_limit (void)
+{
+  return (page_rss_limit != 0
+          && thread_current ()->rss_cnt >= page_rss_limit);
+}
+
+/* If the current process is at its RSS limit, evicts one of its
+   pages to make room for another.  Pages that share a frame with
+   other pages are passed over, because evicting them would not
+   free a frame, and so are pages accessed since the last scan,
+   unless every page has been.  Nothing is evicted if every page
+   is shared or swap is full. */
+static void
+trim_rss (void)
+{
+  struct thread *t = thread_current ();
+  int pass;
+
+  if (!over_rss_limit ())
+    return;
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      struct hash_iterator i;
+
+      hash_first (&i, &t->pages);
+      while (hash_next (&i))
+        {
+          struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+          struct frame *f;
+
+          frame_lock (p);
+          f = p->frame;
+          if (f == NULL)
+            continue;
+          if (f->ref_cnt != 1 || frame_is_zero (f)
+              || (pass == 0 && page_accessed_recently (f)))
+            {
+              frame_unlock (f);
+              continue;
+            }
+          if (page_out (f))
+            {
+              frame_free (f);
+              rss_evict_cnt++;
+            }
+          else
+            frame_unlock (f);
+          return;
+        }
+    }
+}
+
+/* Prints page statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Page: %lld stack pages added on demand, "
+          "%lld pages read ahead from swap\n",
+          stack_growth_cnt, readahead_cnt);
+  printf ("Page: %lld pages mapped to the zero frame, "
+          "%lld of them copied on write\n",
+          zero_map_cnt, zero_copy_cnt);
+  if (page_rss_limit != 0)
+    printf ("Page: %lld pages evicted by processes at their RSS limit\n",
+            rss_evict_cnt);
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Frees the page that E refers to. */
+static void
+destroy_page (struct hash_elem *e, void *aux UNUSED)
+{
+  release_page (hash_entry (e, struct page, hash_elem));
+}
+
+/* Frees page P, which has already been removed from its
+   process's supplemental page table, along with its frame or
+   swap slot, unless other pages still share them.  A modified
+   PAGE_MMAP page is written back. */
+static void
+release_page (struct page *p)
+{
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+      uint32_t *pd = p->thread->pagedir;
+
+      if (p->type == PAGE_MMAP && pagedir_is_dirty (pd, p->upage))
+        file_write_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
+      pagedir_clear_page (pd, p->upage);
+      frame_detach (f, p);
+      if (f->ref_cnt == 0 && !frame_is_zero (f))
+        frame_free (f);
+      else
+        frame_unlock (f);
+    }
+  else if (p->type == PAGE_SWAP)
+    {
+      swap_free (p->swap_slot);
+      count_swapped (p, -1);
+    }
+  free (p);
+}
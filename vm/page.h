@@ -0,0 +1,84 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct frame;
+struct thread;
+
+/* Where a page's contents come from when it is brought in. */
+enum page_type
+  {
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_FILE,                  /* Read from a file, rest zeroed. */
+    PAGE_SWAP,                  /* Private: in swap when not resident. */
+    PAGE_MMAP                   /* Shared with a file: written back. */
+  };
+
+/* A page of a user process's virtual address space.
+
+   Each process keeps a "supplemental page table" of these, a hash
+   table keyed on user virtual address, alongside its hardware
+   page directory.  A page that is present in the supplemental
+   page table is part of the address space even if the page
+   directory does not map it yet; the page fault handler uses the
+   entry to bring the page in on first access.
+
+   A page that the process has modified no longer matches its
+   file or zero-fill backing, so when it is evicted it becomes a
+   PAGE_SWAP page and is written to swap from then on.  The
+   exception is a PAGE_MMAP page, part of a memory-mapped file,
+   which is written back to its file instead.
+
+   After fork, parent and child pages share frames, and swap
+   slots, copy-on-write: a shared frame is mapped read-only in
+   every process that shares it, and the first write to it gives
+   the writer a copy of its own. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *thread;      /* Owning process. */
+    struct hash_elem hash_elem; /* Element in thread's `pages'. */
+    bool writable;              /* Writable by the process? */
+    struct frame *frame;        /* Frame, if resident. */
+    struct list_elem frame_elem; /* Element in frame's `pages'. */
+
+    /* Backing store. */
+    enum page_type type;        /* Where the contents come from. */
+    struct file *file;          /* PAGE_FILE, PAGE_MMAP: File. */
+    off_t file_ofs;             /* PAGE_FILE, PAGE_MMAP: Offset in FILE. */
+    size_t read_bytes;          /* PAGE_FILE, PAGE_MMAP: Bytes in FILE. */
+    size_t swap_slot;           /* PAGE_SWAP: Slot, if not resident. */
+  };
+
+/* Maximum size of a process's stack, in pages. */
+extern size_t page_stack_limit;
+
+/* Number of pages mapped around a fault on a file-backed page. */
+extern size_t page_fault_around;
+
+/* Maximum number of resident pages per process, or 0. */
+extern size_t page_rss_limit;
+
+bool page_table_init (void);
+bool page_table_copy (struct thread *parent);
+void page_table_destroy (void);
+
+struct page *page_allocate (void *upage, bool writable);
+void page_deallocate (void *upage);
+struct page *page_lookup (const void *addr);
+bool page_load (const void *fault_addr, bool write);
+bool page_unshare (const void *fault_addr);
+bool page_grow_stack (const void *fault_addr, const void *esp);
+bool page_out (struct frame *);
+bool page_accessed_recently (struct frame *);
+bool page_mergeable (struct frame *);
+void page_write_protect (struct frame *);
+void page_merge (struct frame *dst, struct frame *src);
+void page_print_stats (void);
+
+#endif /* vm/page.h */
@@ -0,0 +1,238 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/zswap.h"
+
+/* Swap slot allocator.
+
+   The swap partition, the block device in the BLOCK_SWAP role,
+   is divided into page-sized slots of PAGE_SECTORS consecutive
+   sectors each.  A bitmap records which slots hold a page, and a
+   reference count per slot records how many pages share it:
+   pages that shared a frame, after fork or merging, share the
+   slot that the frame was written to when it was evicted.  Any
+   number of identical pages can be merged into one frame, so the
+   count is a full unsigned int.
+
+   If there is no swap partition, every swap_out() fails, so
+   pages that must be written somewhere before their frame is
+   reused cannot be evicted.
+
+   Slots are handed out in clusters of SWAP_CLUSTER consecutive
+   slots, so that pages evicted one after another, which are often
+   virtually adjacent pages of one process, land next to each
+   other on disk and can be read back together by
+   swap_in_multiple().
+
+   If the compressed page store in vm/zswap.c is enabled, a page
+   swapped out goes there first and reaches its slot on disk only
+   if the store writes it back. */
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Number of slots per cluster. */
+#define SWAP_CLUSTER 16
+
+/* The swap device, or a null pointer if there is none. */
+static struct block *swap_device;
+
+/* Bitmap of slots in use. */
+static struct bitmap *used_map;
+
+/* Number of pages that refer to each slot. */
+static unsigned *ref_cnts;
+
+/* Slots left in the current cluster: NEXT_SLOT up to, but not
+   including, CLUSTER_END.  Some may have been taken since. */
+static size_t next_slot, cluster_end;
+
+/* Protects used_map, ref_cnts, next_slot, and cluster_end. */
+static struct lock swap_lock;
+
+/* Statistics. */
+static long long pages_out, pages_in, read_cnt, cluster_cnt;
+
+static size_t alloc_slot (void);
+
+/* Sets up swap. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+  else
+    printf ("swap: no swap device, swapping disabled\n");
+
+  /* The extra count keeps calloc() from failing without swap. */
+  used_map = bitmap_create (slot_cnt);
+  ref_cnts = calloc (slot_cnt + 1, sizeof *ref_cnts);
+  if (used_map == NULL || ref_cnts == NULL)
+    PANIC ("swap: out of memory for slot bitmap");
+  lock_init (&swap_lock);
+
+  if (swap_device != NULL)
+    zswap_init ();
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, with one reference, or SWAP_ERROR if swap is full. */
+size_t
+swap_out (const void *kpage)
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = alloc_slot ();
+  if (slot != BITMAP_ERROR)
+    ref_cnts[slot] = 1;
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_ERROR;
+
+  if (!zswap_store (slot, kpage))
+    swap_write_slot (slot, kpage);
+  return slot;
+}
+
+/* Reads the page in SLOT into KPAGE and drops a reference to
+   SLOT. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  swap_in_multiple (slot, &kpage, 1);
+}
+
+/* Reads the pages in CNT consecutive slots, starting at SLOT,
+   into KPAGES, one page into each element, and drops a reference
+   to each slot.  Pages that are on disk are read with as few
+   requests as possible.  CNT must not exceed SWAP_READAHEAD. */
+void
+swap_in_multiple (size_t slot, void *kpages[], size_t cnt)
+{
+  void *sectors[SWAP_READAHEAD * PAGE_SECTORS];
+  size_t sector_cnt = 0;
+  size_t first = 0;
+  size_t i, j;
+
+  ASSERT (cnt <= SWAP_READAHEAD);
+
+  for (i = 0; i <= cnt; i++)
+    {
+      /* Read the pending run of slots when it ends, at a page
+         found in the compressed store or at the last page. */
+      if (i == cnt || zswap_load (slot + i, kpages[i]))
+        {
+          if (sector_cnt > 0)
+            {
+              block_read_multiple (swap_device, first * PAGE_SECTORS,
+                                   sector_cnt, sectors);
+              pages_in += sector_cnt / PAGE_SECTORS;
+              read_cnt++;
+              sector_cnt = 0;
+            }
+          continue;
+        }
+
+      if (sector_cnt == 0)
+        first = slot + i;
+      for (j = 0; j < PAGE_SECTORS; j++)
+        sectors[sector_cnt++] = (uint8_t *) kpages[i] + j * BLOCK_SECTOR_SIZE;
+    }
+
+  for (i = 0; i < cnt; i++)
+    swap_free (slot + i);
+}
+
+/* Writes the page at KPAGE to SLOT on the swap device. */
+void
+swap_write_slot (size_t slot, const void *kpage)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_write (swap_device, slot * PAGE_SECTORS + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  pages_out++;
+}
+
+/* Adds a reference to SLOT, for another page that shares it. */
+void
+swap_dup (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_map, slot));
+  ASSERT (ref_cnts[slot] < UINT_MAX);
+  ref_cnts[slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to SLOT without reading it, freeing SLOT
+   when the last reference goes. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_map, slot));
+  ASSERT (ref_cnts[slot] > 0);
+  if (--ref_cnts[slot] == 0)
+    {
+      zswap_invalidate (slot);
+      bitmap_reset (used_map, slot);
+    }
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %zu slots, %zu in use, %lld clusters, %lld pages out, "
+          "%lld pages in by %lld reads\n",
+          bitmap_size (used_map), bitmap_count (used_map, 0,
+                                                bitmap_size (used_map), true),
+          cluster_cnt, pages_out, pages_in, read_cnt);
+}
+
+/* Allocates a free slot and returns it, or BITMAP_ERROR if swap
+   is full.  Takes the next free slot of the current cluster if
+   there is one, or else starts a new cluster in the first run of
+   SWAP_CLUSTER free slots.  When swap is too fragmented for
+   that, takes any free slot.  The caller must hold swap_lock. */
+static size_t
+alloc_slot (void)
+{
+  size_t slot;
+
+  while (next_slot < cluster_end)
+    {
+      slot = next_slot++;
+      if (!bitmap_test (used_map, slot))
+        {
+          bitmap_mark (used_map, slot);
+          return slot;
+        }
+    }
+
+  slot = bitmap_scan (used_map, 0, SWAP_CLUSTER, false);
+  if (slot != BITMAP_ERROR)
+    {
+      next_slot = slot + 1;
+      cluster_end = slot + SWAP_CLUSTER;
+      cluster_cnt++;
+      bitmap_mark (used_map, slot);
+      return slot;
+    }
+
+  return bitmap_scan_and_flip (used_map, 0, 1, false);
+}
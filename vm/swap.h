@@ -0,0 +1,23 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returned by swap_out() when no slot is free. */
+#define SWAP_ERROR SIZE_MAX
+
+/* Most slots that swap_in_multiple() reads at once. */
+#define SWAP_READAHEAD 8
+
+void swap_init (void);
+size_t swap_out (const void *kpage);
+void swap_in (size_t slot, void *kpage);
+void swap_in_multiple (size_t slot, void *kpages[], size_t cnt);
+void swap_write_slot (size_t slot, const void *kpage);
+void swap_dup (size_t slot);
+void swap_free (size_t slot);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */
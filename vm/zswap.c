@@ -0,0 +1,250 @@
+#include "vm/zswap.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <lz.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+
+/* Compressed page store in front of swap.
+
+   A page written to swap is first compressed and, if it shrinks
+   enough, kept in kernel memory instead of being written to the
+   swap device.  Each stored page still owns the swap slot that
+   swap_out() allocated for it, so the store is keyed on slot and
+   the rest of the VM system never sees the difference.  When the
+   store grows past zswap_max_pages, the pages that have been in
+   it longest are written back to their slots on disk.
+
+   Pages that compress to more than half a page are not worth
+   keeping: malloc() rounds such a block up to a whole page. */
+
+/* Largest compressed page worth keeping. */
+#define ZSWAP_MAX_SIZE (PGSIZE / 2)
+
+/* -zswap: Maximum size of the store, in pages. */
+size_t zswap_max_pages;
+
+/* A compressed page. */
+struct zswap_entry
+  {
+    size_t slot;                /* Swap slot. */
+    size_t size;                /* Bytes in DATA. */
+    struct hash_elem hash_elem; /* Element in `entries'. */
+    struct list_elem lru_elem;  /* Element in `lru'. */
+    uint8_t data[];             /* Compressed page. */
+  };
+
+/* Stored pages, keyed on slot. */
+static struct hash entries;
+
+/* Stored pages, oldest first. */
+static struct list lru;
+
+/* Bytes of compressed data in the store. */
+static size_t pool_bytes;
+
+/* Scratch space for compression and write-back. */
+static uint16_t match_table[LZ_TABLE_SIZE];
+static uint8_t compress_buf[ZSWAP_MAX_SIZE];
+static uint8_t *writeback_page;
+
+/* Protects all of the above. */
+static struct lock zswap_lock;
+
+/* Statistics. */
+static long long store_cnt, reject_cnt, writeback_cnt;
+static long long hit_cnt, miss_cnt;
+static long long bytes_before, bytes_after;
+
+static struct zswap_entry *find_entry (size_t slot);
+static void remove_entry (struct zswap_entry *);
+static void write_back_oldest (void);
+static hash_hash_func entry_hash;
+static hash_less_func entry_less;
+
+/* Sets up the compressed page store, if it is enabled. */
+void
+zswap_init (void)
+{
+  if (zswap_max_pages == 0)
+    return;
+
+  writeback_page = palloc_get_page (0);
+  if (writeback_page == NULL || !hash_init (&entries, entry_hash,
+                                            entry_less, NULL))
+    PANIC ("zswap: out of memory");
+  list_init (&lru);
+  lock_init (&zswap_lock);
+}
+
+/* Tries to keep the page at KPAGE, destined for swap slot SLOT,
+   in the store.  Returns true if successful, false if the store
+   is disabled or the page does not compress well enough or
+   memory allocation fails, in which case the caller must write
+   the page to SLOT itself. */
+bool
+zswap_store (size_t slot, const void *kpage)
+{
+  struct zswap_entry *e;
+  size_t size;
+
+  if (zswap_max_pages == 0)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  size = lz_compress (kpage, PGSIZE, compress_buf, sizeof compress_buf,
+                      match_table);
+  if (size == 0)
+    goto reject;
+
+  while (pool_bytes + size > zswap_max_pages * PGSIZE && !list_empty (&lru))
+    write_back_oldest ();
+
+  e = malloc (sizeof *e + size);
+  if (e == NULL)
+    goto reject;
+  e->slot = slot;
+  e->size = size;
+  memcpy (e->data, compress_buf, size);
+  hash_insert (&entries, &e->hash_elem);
+  list_push_back (&lru, &e->lru_elem);
+  pool_bytes += size;
+
+  store_cnt++;
+  bytes_before += PGSIZE;
+  bytes_after += size;
+  lock_release (&zswap_lock);
+  return true;
+
+ reject:
+  reject_cnt++;
+  lock_release (&zswap_lock);
+  return false;
+}
+
+/* Reads the page for swap slot SLOT into KPAGE, if it is in the
+   store.  The page stays in the store, because other pages may
+   share the slot.  Returns true if successful, false if the
+   page is on disk instead. */
+bool
+zswap_load (size_t slot, void *kpage)
+{
+  struct zswap_entry *e;
+
+  if (zswap_max_pages == 0)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  e = find_entry (slot);
+  if (e != NULL)
+    {
+      if (lz_decompress (e->data, e->size, kpage, PGSIZE) != PGSIZE)
+        PANIC ("zswap: slot %zu corrupted", slot);
+      hit_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&zswap_lock);
+  return e != NULL;
+}
+
+/* Discards the page for swap slot SLOT, which is being freed,
+   if it is in the store. */
+void
+zswap_invalidate (size_t slot)
+{
+  struct zswap_entry *e;
+
+  if (zswap_max_pages == 0)
+    return;
+
+  lock_acquire (&zswap_lock);
+  e = find_entry (slot);
+  if (e != NULL)
+    remove_entry (e);
+  lock_release (&zswap_lock);
+}
+
+/* Prints compressed store statistics. */
+void
+zswap_print_stats (void)
+{
+  long long loads = hit_cnt + miss_cnt;
+
+  if (zswap_max_pages == 0)
+    return;
+
+  printf ("Zswap: %zu pages in %zu bytes, %lld stored, %lld rejected, "
+          "%lld written back\n",
+          hash_size (&entries), pool_bytes, store_cnt, reject_cnt,
+          writeback_cnt);
+  printf ("Zswap: %lld%% compressed size, %lld%% hit rate, "
+          "%lld disk writes and %lld disk reads avoided\n",
+          bytes_before != 0 ? bytes_after * 100 / bytes_before : 0,
+          loads != 0 ? hit_cnt * 100 / loads : 0,
+          store_cnt - writeback_cnt, hit_cnt);
+}
+
+/* Returns the entry for SLOT, or a null pointer if there is
+   none.  The caller must hold zswap_lock. */
+static struct zswap_entry *
+find_entry (size_t slot)
+{
+  struct zswap_entry key;
+  struct hash_elem *e;
+
+  key.slot = slot;
+  e = hash_find (&entries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct zswap_entry, hash_elem) : NULL;
+}
+
+/* Removes E from the store and frees it.  The caller must hold
+   zswap_lock. */
+static void
+remove_entry (struct zswap_entry *e)
+{
+  hash_delete (&entries, &e->hash_elem);
+  list_remove (&e->lru_elem);
+  pool_bytes -= e->size;
+  free (e);
+}
+
+/* Writes the oldest page in the store to its swap slot and
+   removes it from the store.  The caller must hold zswap_lock,
+   which keeps zswap_load() from reading the slot from disk
+   before the write finishes. */
+static void
+write_back_oldest (void)
+{
+  struct zswap_entry *e = list_entry (list_front (&lru), struct zswap_entry,
+                                      lru_elem);
+
+  if (lz_decompress (e->data, e->size, writeback_page, PGSIZE) != PGSIZE)
+    PANIC ("zswap: slot %zu corrupted", e->slot);
+  swap_write_slot (e->slot, writeback_page);
+  remove_entry (e);
+  writeback_cnt++;
+}
+
+/* Returns a hash value for the entry that E refers to. */
+static unsigned
+entry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct zswap_entry, hash_elem)->slot);
+}
+
+/* Returns true if entry A precedes entry B. */
+static bool
+entry_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct zswap_entry, hash_elem)->slot
+          < hash_entry (b, struct zswap_entry, hash_elem)->slot);
+}
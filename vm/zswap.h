@@ -0,0 +1,17 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Maximum size of the compressed page store, in pages of kernel
+   memory, or 0 to disable it. */
+extern size_t zswap_max_pages;
+
+void zswap_init (void);
+bool zswap_store (size_t slot, const void *kpage);
+bool zswap_load (size_t slot, void *kpage);
+void zswap_invalidate (size_t slot);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */